@@ -0,0 +1,1094 @@
+#include "bench_harness.hpp"
+
+#include "config.hpp"
+#include "run_pool.hpp"
+#include "work_stealing_pool.hpp"
+#include "goblin.hpp"
+#include "goblin_group.hpp"
+#include "goblin_horde.hpp"
+#include "goblin_host.hpp"
+#include "goblin_link.hpp"
+#include "goblin_kill_stream.hpp"
+#include "goblin_simulation.hpp"
+#include "asio_executor.hpp"
+#include "use_goblin_awaitable.hpp"
+#include "use_goblin_future.hpp"
+#include "use_unique_future.hpp"
+
+#include <unistd.h>
+
+#include <future>
+
+namespace {
+
+    auto mode_suffix(goblin_execution_mode mode) -> std::string {
+        return mode == goblin_execution_mode::actor ? "/actor" : "";
+    }
+
+    auto transport_suffix(goblin_transport transport) -> std::string {
+        return transport == goblin_transport::shared_memory ? "/shm" : "";
+    }
+
+    template<class Pool>
+    auto pool_suffix() -> std::string {
+        return std::is_same<Pool, work_stealing_pool>::value ? "/work_stealing" : "";
+    }
+
+    /** An io_service with its own Pool (run_pool or work_stealing_pool) of ctx.threads threads.
+     * Goblins created by a benchmark must be destroyed before the fixture.
+     */
+    template<class Pool>
+    struct basic_goblin_fixture {
+        basic_goblin_fixture(bench::context const &ctx, goblin_execution_mode mode = goblin_execution_mode::locked) {
+            asio::use_service<goblin_service>(executor).set_execution_mode(mode);
+            add_threads(ctx);
+        }
+
+        basic_goblin_fixture(bench::context const &ctx, goblin_execution_mode mode, worker_thread_options workers) {
+            install_worker_threads(executor, workers);
+            asio::use_service<goblin_service>(executor).set_execution_mode(mode);
+            add_threads(ctx);
+        }
+
+        void add_threads(bench::context const &ctx) {
+            for (std::size_t i = 0; i < ctx.threads; ++i) {
+                pool.add_thread();
+            }
+        }
+
+        asio::io_service executor;
+        Pool pool{executor, "bench"};
+    };
+
+    using goblin_fixture = basic_goblin_fixture<run_pool>;
+
+    void construct_throughput(bench::context const &ctx) {
+        goblin_fixture fixture(ctx);
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::vector<std::vector<goblin>> goblins(ctx.threads);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        for (std::size_t t = 0; t < ctx.threads; ++t) {
+            goblins[t].reserve(per_thread);
+            latencies[t].reserve(per_thread);
+        }
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            auto &mine = goblins[t];
+            auto &latency = latencies[t];
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                auto t0 = bench::clock_type::now();
+                mine.emplace_back(fixture.executor);
+                latency.record(t0, bench::clock_type::now());
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        ctx.report("construct", per_thread * ctx.threads, elapsed, latencies[0], allocations.count());
+    }
+
+    /** A horde of goblins constructed, born and killed, in batches of horde_batch with the bulk operations, or
+     * one at a time. Each phase is timed separately, with latencies per batch.
+     */
+    void horde(bench::context const &ctx, bool bulk) {
+        constexpr std::size_t horde_batch = 1024;
+        goblin_fixture fixture(ctx);
+        auto &service = asio::use_service<goblin_service>(fixture.executor);
+
+        auto per_thread = std::max<std::size_t>(horde_batch, ctx.iterations / ctx.threads);
+        auto batches = per_thread / horde_batch;
+        std::vector<std::vector<goblin>> goblins(ctx.threads);
+        for (auto &mine : goblins) mine.reserve(batches * horde_batch);
+
+        auto phase = [&](std::string const &name, auto &&run_batch) {
+            std::vector<bench::latency_recorder> latencies(ctx.threads);
+            bench::allocation_scope allocations;
+            auto start = bench::clock_type::now();
+            bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+                for (std::size_t b = 0; b < batches; ++b) {
+                    auto t0 = bench::clock_type::now();
+                    run_batch(goblins[t], b * horde_batch);
+                    latencies[t].record(t0, bench::clock_type::now());
+                }
+            });
+            auto elapsed = bench::clock_type::now() - start;
+            for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+            auto suffix = bulk ? "" : "/one_by_one";
+            ctx.report("horde/" + name + suffix, batches * horde_batch * ctx.threads, elapsed, latencies[0],
+                       allocations.count());
+        };
+
+        phase("construct", [&](std::vector<goblin> &mine, std::size_t) {
+            if (bulk) {
+                for (auto &impl : service.construct_n(horde_batch)) mine.emplace_back(service, std::move(impl));
+            } else {
+                for (std::size_t i = 0; i < horde_batch; ++i) mine.emplace_back(fixture.executor);
+            }
+        });
+        phase("spawn", [&](std::vector<goblin> &mine, std::size_t first) {
+            auto begin = mine.begin() + std::ptrdiff_t(first);
+            auto end = begin + std::ptrdiff_t(horde_batch);
+            if (bulk) {
+                service.spawn_all(begin, end);
+            } else {
+                std::for_each(begin, end, [](goblin &gob) { gob.be_born(); });
+            }
+        });
+        phase("die", [&](std::vector<goblin> &mine, std::size_t first) {
+            auto begin = mine.begin() + std::ptrdiff_t(first);
+            auto end = begin + std::ptrdiff_t(horde_batch);
+            if (bulk) {
+                service.die_all(begin, end);
+            } else {
+                std::for_each(begin, end, [](goblin &gob) { gob.die(); });
+            }
+        });
+    }
+
+    /** A horde which is mostly idle: constructed dormant, woken by spawn_all, killed and put back to sleep.
+     * The memory an idle goblin costs is worked out from the sizes of what holds it, since slabs are never
+     * returned and blocks cached by earlier benchmarks would hide it.
+     */
+    void dormant_horde(bench::context const &ctx) {
+        goblin_fixture fixture(ctx);
+        auto count = ctx.iterations;
+        std::unique_ptr<goblin_horde> horde;
+
+        auto phase = [&](std::string const &name, auto &&run) {
+            bench::allocation_scope allocations;
+            auto start = bench::clock_type::now();
+            run();
+            auto elapsed = bench::clock_type::now() - start;
+            bench::latency_recorder no_latency;
+            ctx.report("horde/dormant/" + name, count, elapsed, no_latency, allocations.count());
+        };
+
+        phase("construct", [&] { horde = std::make_unique<goblin_horde>(fixture.executor, count); });
+        phase("wake", [&] { horde->spawn_all(); });
+        horde->die_all();
+        phase("hibernate", [&] { horde->hibernate(); });
+
+        auto block = (sizeof(pooled_goblin_block<goblin_impl>) + slab_pool::granularity - 1)
+                     / slab_pool::granularity * slab_pool::granularity;
+        auto constructed = block + sizeof(goblin) + sizeof(goblin_registry<goblin_impl>::value_type);
+        auto dormant = double(sizeof(goblin_horde) + count) / double(count);
+        std::cout << "    bytes per idle goblin: dormant " << dormant << ", constructed " << constructed
+                  << ", awake after hibernate " << horde->awake() << std::endl;
+        horde.reset();
+    }
+
+    /** Supervising a horde: wait for all of it to die, with one goblin_group wait or with a wait_death per
+     * goblin and a countdown, then kill it. Timed from the first death to the supervisor's handler.
+     */
+    void supervise_horde(bench::context const &ctx, bool grouped) {
+        constexpr std::size_t population = 10000;
+        goblin_fixture fixture(ctx);
+        auto &service = asio::use_service<goblin_service>(fixture.executor);
+        auto rounds = std::max<std::size_t>(1, ctx.iterations / population);
+
+        bench::latency_recorder latency;
+        latency.reserve(rounds);
+        bench::allocation_scope allocations;
+        bench::clock_type::duration elapsed{};
+        for (std::size_t round = 0; round < rounds; ++round) {
+            auto goblins = make_goblins(fixture.executor, population);
+            service.spawn_all(goblins.begin(), goblins.end());
+
+            std::promise<void> done;
+            goblin_group group(fixture.executor);
+            std::atomic<std::size_t> remaining{population};
+            if (grouped) {
+                group.add(goblins.begin(), goblins.end());
+                group.async_wait_all_dead([&](asio::error_code const &) { done.set_value(); });
+            } else {
+                for (auto &gob : goblins) {
+                    gob.wait_death([&](asio::error_code const &) {
+                        if (remaining.fetch_sub(1) == 1) done.set_value();
+                    });
+                }
+            }
+
+            auto t0 = bench::clock_type::now();
+            service.die_all(goblins.begin(), goblins.end());
+            done.get_future().wait();
+            auto t1 = bench::clock_type::now();
+            latency.record(t0, t1);
+            elapsed += t1 - t0;
+        }
+        ctx.report(grouped ? "supervise/group" : "supervise/wait_death", rounds * population, elapsed, latency,
+                   allocations.count());
+    }
+
+    /** Supervising a horde hosted by another io_service, over a goblin_link: construct it, give birth to it and
+     * wait for every goblin's death, then kill it, all pipelined over one Unix domain socket. Timed from the first
+     * construction to the last death handler; compare with supervise/wait_death, which does the same locally.
+     */
+    void remote_supervise(bench::context const &ctx, goblin_transport transport) {
+        constexpr std::size_t population = 1000;
+        goblin_fixture host_fixture(ctx);
+        goblin_fixture fixture(ctx);
+        auto path = "/tmp/tiggle-bench-" + std::to_string(::getpid()) + ".sock";
+        goblin_host host(host_fixture.executor, path);
+        goblin_link link(fixture.executor, path, transport);
+        auto rounds = std::max<std::size_t>(1, ctx.iterations / population);
+
+        bench::latency_recorder latency;
+        latency.reserve(rounds);
+        bench::allocation_scope allocations;
+        bench::clock_type::duration elapsed{};
+        for (std::size_t round = 0; round < rounds; ++round) {
+            std::promise<void> done;
+            std::atomic<std::size_t> remaining{population};
+
+            auto t0 = bench::clock_type::now();
+            std::vector<remote_goblin> goblins;
+            goblins.reserve(population);
+            for (std::size_t i = 0; i < population; ++i) goblins.emplace_back(link);
+            spawn_all(goblins);
+            for (auto &gob : goblins) {
+                gob.wait_death([&](asio::error_code const &) {
+                    if (remaining.fetch_sub(1) == 1) done.set_value();
+                });
+            }
+            die_all(goblins);
+            done.get_future().wait();
+            auto t1 = bench::clock_type::now();
+            latency.record(t0, t1);
+            elapsed += t1 - t0;
+        }
+        ctx.report("remote/supervise" + transport_suffix(transport), rounds * population, elapsed, latency,
+                   allocations.count());
+    }
+
+    /** Events sent to hosted goblins from ctx.threads threads: die() to goblins which are dead already, so that
+     * the host does the least work per event. Timed until a wait sent after the last event has been answered,
+     * which the host only does once it has handled every event before it.
+     */
+    void remote_events(bench::context const &ctx, goblin_transport transport) {
+        constexpr std::size_t population = 64;
+        goblin_fixture host_fixture(ctx);
+        goblin_fixture fixture(ctx);
+        auto path = "/tmp/tiggle-bench-" + std::to_string(::getpid()) + ".sock";
+        goblin_host host(host_fixture.executor, path);
+        goblin_link link(fixture.executor, path, transport);
+
+        std::vector<remote_goblin> goblins;
+        for (std::size_t i = 0; i < population; ++i) goblins.emplace_back(link);
+        std::vector<goblin_ref> refs(goblins.begin(), goblins.end());
+        spawn_all(goblins);
+        die_all(goblins);
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        for (auto &latency : latencies) latency.reserve(per_thread);
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                auto t0 = bench::clock_type::now();
+                refs[(i + t) % population].die();
+                latencies[t].record(t0, bench::clock_type::now());
+            }
+        });
+        std::promise<void> done;
+        goblins.front().wait_death([&](asio::error_code const &) { done.set_value(); });
+        done.get_future().wait();
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        ctx.report("remote/events" + transport_suffix(transport), per_thread * ctx.threads, elapsed, latencies[0],
+                   allocations.count());
+    }
+
+    /** Steady spawn/die load: each thread keeps a window of live goblins, replacing the oldest on every
+     * iteration. Reports the registry's slot count afterwards, which should track the live population
+     * rather than the number of goblins ever constructed.
+     */
+    void construct_churn(bench::context const &ctx) {
+        goblin_fixture fixture(ctx);
+
+        constexpr std::size_t window = 64;
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        std::vector<std::vector<goblin>> goblins(ctx.threads);
+        for (std::size_t t = 0; t < ctx.threads; ++t) {
+            goblins[t].reserve(window);
+            latencies[t].reserve(per_thread);
+        }
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            auto &live = goblins[t];
+            auto &latency = latencies[t];
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                auto t0 = bench::clock_type::now();
+                if (live.size() < window) {
+                    live.emplace_back(fixture.executor);
+                } else {
+                    live[i % window] = goblin(fixture.executor);
+                }
+                latency.record(t0, bench::clock_type::now());
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        ctx.report("construct/churn", per_thread * ctx.threads, elapsed, latencies[0], allocations.count());
+        std::cout << "    registry slots after churn: "
+                  << asio::use_service<goblin_service>(fixture.executor).registry().capacity()
+                  << " (live goblins at peak: " << window * ctx.threads << ")" << std::endl;
+    }
+
+    /** Many threads hammering a handful of (dead) goblins with events that the state machine accepts but
+     * ignores, so that we measure dispatch and lock contention rather than the cost of any action.
+     * In actor mode this is the cost to the caller of posting the event to the goblin's mailbox.
+     */
+    void process_event_contention(bench::context const &ctx, goblin_execution_mode mode) {
+        goblin_fixture fixture(ctx, mode);
+
+        constexpr std::size_t goblin_count = 4;
+        std::vector<goblin> goblins;
+        for (std::size_t i = 0; i < goblin_count; ++i) {
+            goblins.emplace_back(fixture.executor);
+            goblins.back().be_born();
+            goblins.back().die();
+        }
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        for (auto &latency : latencies) latency.reserve(per_thread);
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            auto &latency = latencies[t];
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                auto &gob = goblins[(i + t) % goblin_count];
+                auto t0 = bench::clock_type::now();
+                gob.die();
+                latency.record(t0, bench::clock_type::now());
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        ctx.report("process_event/contended" + mode_suffix(mode), per_thread * ctx.threads, elapsed, latencies[0], allocations.count());
+    }
+
+    /** Time from initiating async_spawn or wait_death to the completion handler running on the io_service,
+     * i.e. the full trip through a goblin_waiter and its completion_batch.
+     */
+    template<class Pool = run_pool>
+    void spawn_death_round_trip(bench::context const &ctx, goblin_execution_mode mode) {
+        basic_goblin_fixture<Pool> fixture(ctx, mode);
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / 10 / ctx.threads);
+        std::vector<bench::latency_recorder> spawn_latencies(ctx.threads);
+        std::vector<bench::latency_recorder> death_latencies(ctx.threads);
+        for (std::size_t t = 0; t < ctx.threads; ++t) {
+            spawn_latencies[t].reserve(per_thread);
+            death_latencies[t].reserve(per_thread);
+        }
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                goblin gob(fixture.executor);
+
+                std::atomic<bool> born{false};
+                auto t0 = bench::clock_type::now();
+                gob.async_spawn([&born](asio::error_code const &) { born.store(true); });
+                bench::spin_until([&] { return born.load(); });
+                spawn_latencies[t].record(t0, bench::clock_type::now());
+
+                std::atomic<bool> dead{false};
+                auto t1 = bench::clock_type::now();
+                gob.wait_death([&dead](asio::error_code const &) { dead.store(true); });
+                gob.die();
+                bench::spin_until([&] { return dead.load(); });
+                death_latencies[t].record(t1, bench::clock_type::now());
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) {
+            spawn_latencies[0].merge(spawn_latencies[t]);
+            death_latencies[0].merge(death_latencies[t]);
+        }
+        // allocations are for the whole construct/spawn/die cycle
+        auto cycle_allocations = allocations.count();
+        auto suffix = mode_suffix(mode) + pool_suffix<Pool>();
+        ctx.report("async_spawn/round_trip" + suffix, per_thread * ctx.threads, elapsed,
+                   spawn_latencies[0], cycle_allocations);
+        ctx.report("wait_death/round_trip" + suffix, per_thread * ctx.threads, elapsed,
+                   death_latencies[0], cycle_allocations);
+    }
+
+    /** One goblin with many death waiters. Measures how long die() holds the goblin while it fires every
+     * waiter, and how long until the last waiter's completion handler has run.
+     */
+    template<class Pool = run_pool>
+    void death_fan_out(bench::context const &ctx, goblin_execution_mode mode) {
+        for (std::size_t waiters : {1, 10, 100, 1000, 10000}) {
+            basic_goblin_fixture<Pool> fixture(ctx, mode);
+
+            auto repetitions = std::min<std::size_t>(1000, std::max<std::size_t>(5, ctx.iterations / waiters));
+            bench::latency_recorder die_latency;
+            bench::latency_recorder complete_latency;
+            bench::clock_type::duration die_elapsed{};
+            bench::clock_type::duration elapsed{};
+            die_latency.reserve(repetitions);
+            complete_latency.reserve(repetitions);
+            std::size_t waiter_allocations = 0;
+
+            for (std::size_t r = 0; r < repetitions; ++r) {
+                goblin gob(fixture.executor);
+                gob.be_born();
+
+                std::atomic<std::size_t> completed{0};
+                bench::allocation_scope allocations;
+                for (std::size_t w = 0; w < waiters; ++w) {
+                    gob.wait_death([&completed](asio::error_code const &) { completed.fetch_add(1); });
+                }
+
+                auto t0 = bench::clock_type::now();
+                gob.die();
+                auto t1 = bench::clock_type::now();
+                bench::spin_until([&] { return completed.load() == waiters; });
+                auto t2 = bench::clock_type::now();
+                waiter_allocations += allocations.count();
+
+                die_latency.record(t0, t1);
+                complete_latency.record(t0, t2);
+                die_elapsed += t1 - t0;
+                elapsed += t2 - t0;
+            }
+
+            auto name = "death_fan_out/" + std::to_string(waiters) + mode_suffix(mode) + pool_suffix<Pool>();
+            ctx.report(name + "/die", repetitions, die_elapsed, die_latency);
+            // allocations are for registering and firing each waiter
+            ctx.report(name + "/complete", repetitions * waiters, elapsed, complete_latency, waiter_allocations);
+        }
+    }
+
+    /** Event throughput of actor goblins when their mailboxes are drained by the worker threads.
+     * Each caller thread owns a few dead goblins and floods them with events; the clock stops when a final
+     * death waiter on every goblin has completed, i.e. when the workers have drained every mailbox.
+     */
+    void worker_throughput(bench::context const &ctx, std::string const &name, worker_thread_options workers) {
+        goblin_fixture fixture(ctx, goblin_execution_mode::actor, workers);
+
+        constexpr std::size_t goblins_per_thread = 16;
+        std::vector<std::vector<goblin>> goblins(ctx.threads);
+        for (auto &mine : goblins) {
+            for (std::size_t i = 0; i < goblins_per_thread; ++i) {
+                mine.emplace_back(fixture.executor);
+                mine.back().be_born();
+                mine.back().die();
+            }
+        }
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::atomic<std::size_t> drained{0};
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            auto &mine = goblins[t];
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                mine[i % goblins_per_thread].die();
+            }
+            for (auto &gob : mine) {
+                gob.wait_death([&drained](asio::error_code const &) { drained.fetch_add(1); });
+            }
+        });
+        bench::spin_until([&] { return drained.load() == goblins_per_thread * ctx.threads; });
+        auto elapsed = bench::clock_type::now() - start;
+
+        // per-event latency is not meaningful here; only throughput is reported
+        bench::latency_recorder no_latency;
+        ctx.report(name, per_thread * ctx.threads, elapsed, no_latency, allocations.count());
+    }
+
+    auto worker_config(std::size_t threads_per_executor, bool sharded) {
+        worker_thread_options options;
+        options.threads_per_executor = threads_per_executor;
+        options.sharded = sharded;
+        return options;
+    }
+
+    /** Every thread repeatedly polls is_dead() across a large population, as main's all_dead does, while the
+     * goblins are being killed. Readers never touch a goblin's mutex, so they neither contend with each other nor
+     * with the events.
+     */
+    void is_dead_scan(bench::context const &ctx) {
+        goblin_fixture fixture(ctx);
+
+        constexpr std::size_t population = 100000;
+        std::vector<goblin> goblins;
+        goblins.reserve(population);
+        for (std::size_t i = 0; i < population; ++i) {
+            goblins.emplace_back(fixture.executor);
+            goblins.back().be_born();
+        }
+
+        auto passes = std::max<std::size_t>(1, ctx.iterations / population);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        std::atomic<std::size_t> seen_dead{0};
+
+        std::atomic<bool> killing{true};
+        std::thread killer([&] {
+            for (auto &gob : goblins) {
+                if (not killing.load()) break;
+                gob.die();
+            }
+        });
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t pass = 0; pass < passes; ++pass) {
+                auto t0 = bench::clock_type::now();
+                std::size_t dead = 0;
+                for (auto const &gob : goblins) {
+                    dead += gob.is_dead();
+                }
+                latencies[t].record(t0, bench::clock_type::now());
+                seen_dead.fetch_add(dead, std::memory_order_relaxed);
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+        killing.store(false);
+        killer.join();
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        // latencies are per pass over the whole population
+        ctx.report("is_dead/scan", passes * population * ctx.threads, elapsed, latencies[0], allocations.count());
+    }
+
+    /** is_dead/scan answered by the goblin world instead: one count_dead() per pass over the same population */
+    void world_count_dead(bench::context const &ctx) {
+        goblin_fixture fixture(ctx);
+        auto &service = asio::use_service<goblin_service>(fixture.executor);
+        service.enable_world();
+        auto &world = *service.world();
+
+        constexpr std::size_t population = 100000;
+        std::vector<goblin> goblins;
+        goblins.reserve(population);
+        for (std::size_t i = 0; i < population; ++i) {
+            goblins.emplace_back(fixture.executor);
+            goblins.back().be_born();
+        }
+
+        auto passes = std::max<std::size_t>(1, ctx.iterations / population);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        std::atomic<std::size_t> seen_dead{0};
+
+        std::atomic<bool> killing{true};
+        std::thread killer([&] {
+            for (auto &gob : goblins) {
+                if (not killing.load()) break;
+                gob.die();
+            }
+        });
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t pass = 0; pass < passes; ++pass) {
+                auto t0 = bench::clock_type::now();
+                auto dead = world.count_dead();
+                latencies[t].record(t0, bench::clock_type::now());
+                seen_dead.fetch_add(dead, std::memory_order_relaxed);
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+        killing.store(false);
+        killer.join();
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        ctx.report("world/count_dead", passes * population * ctx.threads, elapsed, latencies[0], allocations.count());
+    }
+
+    /** for_each_due over a world of a million slots, one in 64 of them due */
+    void world_due(bench::context const &ctx) {
+        constexpr std::size_t population = 1000000;
+        goblin_world world;
+        auto now = goblin_world::clock_type::now();
+        for (std::size_t i = 0; i < population; ++i) {
+            auto slot = world.allocate(i);
+            world.set_state(slot, std::uint8_t(goblin_state_id::killing_folk), true, false);
+            auto delay = i % 64 == 0 ? std::chrono::seconds(0) : std::chrono::seconds(60);
+            world.set_deadline(slot, now + delay);
+        }
+
+        auto passes = std::max<std::size_t>(1, ctx.iterations / population);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        std::atomic<std::size_t> seen_due{0};
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t pass = 0; pass < passes; ++pass) {
+                auto t0 = bench::clock_type::now();
+                std::size_t due = 0;
+                world.for_each_due(now + std::chrono::seconds(1), [&](std::uint32_t, std::uint64_t) { ++due; });
+                latencies[t].record(t0, bench::clock_type::now());
+                seen_due.fetch_add(due, std::memory_order_relaxed);
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        ctx.report("world/due", passes * population * ctx.threads, elapsed, latencies[0], allocations.count());
+    }
+
+    /** ctx.threads threads publish kills, as goblins would, to one blocking goblin_kill_stream.
+     * allocs/op shows how many kills share each batch.
+     */
+    void kill_stream(bench::context const &ctx) {
+        goblin_fixture fixture(ctx);
+        auto &hub = asio::use_service<goblin_service>(fixture.executor).kill_hub();
+        goblin_kill_stream stream(fixture.executor, goblin_kill_stream::default_capacity, kill_overflow::block);
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        auto total = per_thread * ctx.threads;
+        std::size_t received = 0;
+        std::promise<void> done;
+
+        std::function<void(asio::error_code, goblin_kill_stream::batch_type)> consume;
+        consume = [&](asio::error_code ec, goblin_kill_stream::batch_type batch) {
+            received += batch.size();
+            if (ec or received == total) {
+                done.set_value();
+                return;
+            }
+            stream.async_next_kills(consume);
+        };
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        stream.async_next_kills(consume);
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                hub.publish(goblin_kill{t, bench::clock_type::now()});
+            }
+        });
+        done.get_future().wait();
+        auto elapsed = bench::clock_type::now() - start;
+
+        bench::latency_recorder no_latency;
+        ctx.report("kills/stream", total, elapsed, no_latency, allocations.count());
+    }
+
+    /** An hour of goblin life in virtual time, on this thread whatever ctx.threads is. Goblins are born in
+     * batches spread over the hour, each kills once five seconds later, and the survivors die at the end.
+     * Counts the kills the stream delivers, so the rate is kills per second of real time.
+     */
+    void simulated_hour(bench::context const &ctx) {
+        constexpr std::size_t batches = 3600;
+        auto per_batch = std::max<std::size_t>(1, ctx.iterations / batches);
+
+        asio::io_service executor;
+        goblin_simulation simulation(executor);
+        goblin_kill_stream stream(executor, batches * per_batch);
+
+        std::size_t killed = 0;
+        std::function<void(asio::error_code, goblin_kill_stream::batch_type)> consume;
+        consume = [&](asio::error_code ec, goblin_kill_stream::batch_type batch) {
+            killed += batch.size();
+            if (not ec) stream.async_next_kills(consume);
+        };
+        stream.async_next_kills(consume);
+
+        std::vector<goblin> goblins;
+        goblins.reserve(batches * per_batch);
+        std::size_t born = 0;
+        wheel_timer spawner(executor);
+        std::function<void()> spawn = [&] {
+            auto batch = make_goblins(executor, per_batch);
+            spawn_all(batch);
+            std::move(batch.begin(), batch.end(), std::back_inserter(goblins));
+            if (++born < batches) spawner.async_wait_for(std::chrono::seconds(1), spawn);
+        };
+        spawner.async_wait_for(std::chrono::seconds(1), spawn);
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        simulation.run_for(std::chrono::hours(1));
+        die_all(goblins);
+        simulation.run();
+        auto elapsed = bench::clock_type::now() - start;
+
+        stream.close();
+        goblins.clear();
+        simulation.poll();
+
+        bench::latency_recorder no_latency;
+        ctx.report("simulation/hour", killed, elapsed, no_latency, allocations.count());
+    }
+
+    /** Logging-style access to goblin names from many threads at once */
+    void name_access(bench::context const &ctx) {
+        goblin_fixture fixture(ctx);
+
+        constexpr std::size_t goblin_count = 64;
+        std::vector<goblin> goblins;
+        for (std::size_t i = 0; i < goblin_count; ++i) {
+            goblins.emplace_back(fixture.executor);
+        }
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        for (auto &latency : latencies) latency.reserve(per_thread);
+        std::atomic<std::size_t> characters{0};
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            std::size_t total = 0;
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                auto t0 = bench::clock_type::now();
+                auto name = goblins[(i + t) % goblin_count].name();
+                total += name.size();
+                latencies[t].record(t0, bench::clock_type::now());
+            }
+            characters.fetch_add(total);
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        ctx.report("name", per_thread * ctx.threads, elapsed, latencies[0], allocations.count());
+    }
+
+    /** Passing goblin references between threads and asking each whether its goblin is dead: by goblin_ref, a
+     * generational handle, or by copying the shared_ptr to the implementation, as goblin_ref used to. Every
+     * thread uses the same goblins, so the shared_ptr copies contend on their reference counts.
+     */
+    void ref_pass(bench::context const &ctx, bool by_handle) {
+        goblin_fixture fixture(ctx);
+
+        constexpr std::size_t goblin_count = 64;
+        std::vector<goblin> goblins;
+        for (std::size_t i = 0; i < goblin_count; ++i) {
+            goblins.emplace_back(fixture.executor);
+        }
+        std::vector<goblin_ref> refs(goblins.begin(), goblins.end());
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        for (auto &latency : latencies) latency.reserve(per_thread);
+        std::atomic<std::size_t> seen_dead{0};
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            std::size_t dead = 0;
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                auto t0 = bench::clock_type::now();
+                if (by_handle) {
+                    auto ref = refs[(i + t) % goblin_count];
+                    dead += ref.is_dead();
+                } else {
+                    auto impl = goblins[(i + t) % goblin_count].get_implementation();
+                    dead += impl->snapshot().is_dead();
+                }
+                latencies[t].record(t0, bench::clock_type::now());
+            }
+            seen_dead.fetch_add(dead);
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        ctx.report(by_handle ? "ref/handle" : "ref/shared_ptr", per_thread * ctx.threads, elapsed, latencies[0],
+                   allocations.count());
+    }
+
+    /** async_spawn returning a future, with a continuation attached through then(). Measures the time until the
+     * continuation has run and the allocations for the whole cycle, for use_unique_future and use_goblin_future.
+     */
+    template<class Token>
+    void future_round_trip(bench::context const &ctx, std::string const &name, Token token) {
+        goblin_fixture fixture(ctx);
+        auto continuation_executor = make_asio_executor(fixture.executor);
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / 10 / ctx.threads);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        for (auto &latency : latencies) latency.reserve(per_thread);
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                goblin gob(fixture.executor);
+
+                std::atomic<bool> born{false};
+                auto t0 = bench::clock_type::now();
+                auto next = gob.async_spawn(token).then(continuation_executor, [&born](auto f) {
+                    f.get();
+                    born.store(true);
+                });
+                bench::spin_until([&] { return born.load(); });
+                latencies[t].record(t0, bench::clock_type::now());
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        // allocations are for the whole construct/spawn/continue cycle
+        ctx.report(name, per_thread * ctx.threads, elapsed, latencies[0], allocations.count());
+    }
+
+#if defined(__cpp_impl_coroutine)
+    goblin_task supervise(std::vector<goblin> &goblins, std::atomic<bool> &finished) {
+        for (auto &gob : goblins) {
+            co_await gob.async_spawn(use_goblin_awaitable);
+        }
+        for (auto &gob : goblins) {
+            auto death = gob.wait_death(use_goblin_awaitable);
+            gob.die();
+            co_await death;
+        }
+        finished.store(true);
+    }
+
+    /** One coroutine brings a population of goblins to life and then kills them, awaiting each birth and death.
+     * Allocations are for the coroutine frame and every await, not for the goblins.
+     */
+    void coroutine_supervise(bench::context const &ctx) {
+        goblin_fixture fixture(ctx);
+
+        auto count = std::max<std::size_t>(1, ctx.iterations / 10);
+        std::vector<goblin> goblins;
+        goblins.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) goblins.emplace_back(fixture.executor);
+
+        std::atomic<bool> finished{false};
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        supervise(goblins, finished);
+        bench::spin_until([&] { return finished.load(); });
+        auto elapsed = bench::clock_type::now() - start;
+
+        bench::latency_recorder no_latency;
+        ctx.report("coroutine/supervise", count, elapsed, no_latency, allocations.count());
+    }
+#endif
+
+    /** The cost of the instrumentation on every locked process_event: a timestamp, a counter and a histogram
+     * sample. Free unless built with GOBLINS_ENABLE_METRICS.
+     */
+    void metrics_record(bench::context const &ctx) {
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::vector<bench::latency_recorder> latencies(ctx.threads);
+        for (auto &latency : latencies) latency.reserve(per_thread);
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                auto t0 = bench::clock_type::now();
+                auto locked_at = goblin_metrics::now();
+                goblin_metrics::event_processed();
+                goblin_metrics::lock_held(locked_at);
+                latencies[t].record(t0, bench::clock_type::now());
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+        auto name = std::string("metrics/record") + (goblin_metrics::enabled ? "" : "/disabled");
+        ctx.report(name, per_thread * ctx.threads, elapsed, latencies[0], allocations.count());
+    }
+
+    /** The cost of tracing one event into this thread's ring */
+    void trace_record(bench::context const &ctx) {
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+            for (std::size_t i = 0; i < per_thread; ++i) {
+                goblin_trace::record(i, trace_event::dies, 1, 2);
+            }
+        });
+        auto elapsed = bench::clock_type::now() - start;
+
+        // too quick to time individually
+        bench::latency_recorder no_latency;
+        ctx.report("trace/record", per_thread * ctx.threads, elapsed, no_latency, allocations.count());
+    }
+
+    /** The state machine back-ends side by side, whichever one GoblinState is.
+     * lifecycle: start, add a birth waiter, be born, add a death waiter, die and stop, on a fresh machine.
+     * dispatch: GoblinDies to a machine which is already dead, i.e. the cost of dispatch alone.
+     */
+    template<class Machine>
+    void state_machine_cost(bench::context const &ctx, std::string const &name) {
+        asio::io_service executor;
+        auto impl = std::make_shared<goblin_impl>(executor, 0, goblin_name("bench"));
+        auto ignore = [](asio::error_code const &) {};
+        auto per_phase = std::max<std::size_t>(1, ctx.iterations / 10);
+
+        bench::latency_recorder lifecycle_latency;
+        lifecycle_latency.reserve(per_phase);
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        for (std::size_t i = 0; i < per_phase; ++i) {
+            auto t0 = bench::clock_type::now();
+            Machine machine;
+            machine.start();
+            machine.process_event(EventAddBirthHandler{ignore});
+            machine.process_event(GoblinBorn{*impl});
+            machine.process_event(EventAddDeathHandler{ignore});
+            machine.process_event(GoblinDies{*impl});
+            machine.stop();
+            lifecycle_latency.record(t0, bench::clock_type::now());
+        }
+        auto elapsed = bench::clock_type::now() - start;
+        ctx.report("fsm/" + name + "/lifecycle", per_phase, elapsed, lifecycle_latency, allocations.count());
+
+        Machine dead;
+        dead.start();
+        dead.process_event(GoblinBorn{*impl});
+        dead.process_event(GoblinDies{*impl});
+        start = bench::clock_type::now();
+        for (std::size_t i = 0; i < ctx.iterations; ++i) {
+            dead.process_event(GoblinDies{*impl});
+        }
+        elapsed = bench::clock_type::now() - start;
+        bench::latency_recorder no_latency;
+        ctx.report("fsm/" + name + "/dispatch", ctx.iterations, elapsed, no_latency);
+        dead.stop();
+    }
+
+    /** Fine-grained posting: every pool thread runs a task which posts a stream of tiny tasks, as happens when
+     * many goblins complete at once. Compares asio's single shared queue with the work-stealing deques.
+     */
+    template<class Pool, class Post>
+    void post_throughput(bench::context const &ctx, std::string const &name, Post post) {
+        asio::io_service executor;
+        Pool pool{executor, "bench"};
+        for (std::size_t i = 0; i < ctx.threads; ++i) pool.add_thread();
+
+        auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+        std::atomic<std::size_t> done{0};
+
+        bench::allocation_scope allocations;
+        auto start = bench::clock_type::now();
+        for (std::size_t t = 0; t < ctx.threads; ++t) {
+            post(executor, [&, per_thread] {
+                for (std::size_t i = 0; i < per_thread; ++i) {
+                    post(executor, [&done] { done.fetch_add(1, std::memory_order_relaxed); });
+                }
+            });
+        }
+        bench::spin_until([&] { return done.load() == per_thread * ctx.threads; });
+        auto elapsed = bench::clock_type::now() - start;
+
+        bench::latency_recorder no_latency;
+        ctx.report(name, per_thread * ctx.threads, elapsed, no_latency, allocations.count());
+    }
+
+    void post_run_pool(bench::context const &ctx) {
+        post_throughput<run_pool>(ctx, "post/run_pool", [](asio::io_service &executor, auto &&f) {
+            executor.post(std::forward<decltype(f)>(f));
+        });
+    }
+
+    void post_work_stealing(bench::context const &ctx) {
+        post_throughput<work_stealing_pool>(ctx, "post/work_stealing", [](asio::io_service &executor, auto &&f) {
+            work_stealing_executor(executor).post(std::forward<decltype(f)>(f));
+        });
+    }
+
+    bench::registrar construct_registrar("construct", construct_throughput);
+    bench::registrar churn_registrar("construct/churn", construct_churn);
+    bench::registrar supervise_group_registrar("supervise/group", [](bench::context const &ctx) {
+        supervise_horde(ctx, true);
+    });
+    bench::registrar supervise_wait_death_registrar("supervise/wait_death", [](bench::context const &ctx) {
+        supervise_horde(ctx, false);
+    });
+    bench::registrar remote_supervise_registrar("remote/supervise", [](bench::context const &ctx) {
+        remote_supervise(ctx, goblin_transport::socket);
+    });
+    bench::registrar remote_supervise_shm_registrar("remote/supervise/shm", [](bench::context const &ctx) {
+        remote_supervise(ctx, goblin_transport::shared_memory);
+    });
+    bench::registrar remote_events_registrar("remote/events", [](bench::context const &ctx) {
+        remote_events(ctx, goblin_transport::socket);
+    });
+    bench::registrar remote_events_shm_registrar("remote/events/shm", [](bench::context const &ctx) {
+        remote_events(ctx, goblin_transport::shared_memory);
+    });
+    bench::registrar horde_registrar("horde", [](bench::context const &ctx) { horde(ctx, true); });
+    bench::registrar dormant_horde_registrar("horde/dormant", dormant_horde);
+    bench::registrar horde_one_by_one_registrar("horde/one_by_one", [](bench::context const &ctx) {
+        horde(ctx, false);
+    });
+
+    template<class F>
+    auto in_mode(F f, goblin_execution_mode mode) {
+        return [f, mode](bench::context const &ctx) { f(ctx, mode); };
+    }
+
+    constexpr auto locked = goblin_execution_mode::locked;
+    constexpr auto actor = goblin_execution_mode::actor;
+
+    bench::registrar process_event_registrar("process_event", in_mode(process_event_contention, locked));
+    bench::registrar process_event_actor_registrar("process_event/actor", in_mode(process_event_contention, actor));
+    bench::registrar round_trip_registrar("round_trip", in_mode(spawn_death_round_trip<run_pool>, locked));
+    bench::registrar round_trip_actor_registrar("round_trip/actor", in_mode(spawn_death_round_trip<run_pool>, actor));
+    bench::registrar fan_out_registrar("death_fan_out", in_mode(death_fan_out<run_pool>, locked));
+    bench::registrar fan_out_actor_registrar("death_fan_out/actor", in_mode(death_fan_out<run_pool>, actor));
+    bench::registrar round_trip_ws_registrar("round_trip/work_stealing",
+                                             in_mode(spawn_death_round_trip<work_stealing_pool>, locked));
+    bench::registrar fan_out_ws_registrar("death_fan_out/work_stealing",
+                                          in_mode(death_fan_out<work_stealing_pool>, locked));
+    bench::registrar name_registrar("name", name_access);
+    bench::registrar is_dead_scan_registrar("is_dead/scan", is_dead_scan);
+    bench::registrar ref_handle_registrar("ref/handle", [](bench::context const &ctx) { ref_pass(ctx, true); });
+    bench::registrar ref_shared_ptr_registrar("ref/shared_ptr", [](bench::context const &ctx) {
+        ref_pass(ctx, false);
+    });
+    bench::registrar world_count_dead_registrar("world/count_dead", world_count_dead);
+    bench::registrar world_due_registrar("world/due", world_due);
+    bench::registrar kill_stream_registrar("kills/stream", kill_stream);
+    bench::registrar simulated_hour_registrar("simulation/hour", simulated_hour);
+    bench::registrar unique_future_registrar("future/unique_future", [](bench::context const &ctx) {
+        future_round_trip(ctx, "future/unique_future", use_unique_future);
+    });
+    bench::registrar goblin_future_registrar("future/goblin_future", [](bench::context const &ctx) {
+        future_round_trip(ctx, "future/goblin_future", use_goblin_future);
+    });
+#if defined(__cpp_impl_coroutine)
+    bench::registrar coroutine_supervise_registrar("coroutine/supervise", coroutine_supervise);
+#endif
+    bench::registrar metrics_record_registrar("metrics/record", metrics_record);
+    bench::registrar trace_record_registrar("trace/record", trace_record);
+    bench::registrar fsm_msm_registrar("fsm/msm", [](bench::context const &ctx) {
+        state_machine_cost<MsmGoblinState>(ctx, "msm");
+    });
+    bench::registrar fsm_table_registrar("fsm/table", [](bench::context const &ctx) {
+        state_machine_cost<TableGoblinState>(ctx, "table");
+    });
+    bench::registrar post_run_pool_registrar("post/run_pool", post_run_pool);
+    bench::registrar post_work_stealing_registrar("post/work_stealing", post_work_stealing);
+    bench::registrar workers_single_registrar("workers/single", [](bench::context const &ctx) {
+        worker_throughput(ctx, "workers/single", worker_config(1, false));
+    });
+    bench::registrar workers_pool_registrar("workers/pool", [](bench::context const &ctx) {
+        worker_throughput(ctx, "workers/pool", worker_config(std::thread::hardware_concurrency(), false));
+    });
+    bench::registrar workers_sharded_registrar("workers/sharded", [](bench::context const &ctx) {
+        worker_throughput(ctx, "workers/sharded", worker_thread_options::per_core());
+    });
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+    using clock_type = std::chrono::steady_clock;
+
+    inline auto nanoseconds_between(clock_type::time_point first, clock_type::time_point last) -> std::uint64_t {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(last - first).count());
+    }
+
+    /** The number of calls to the global operator new made so far by the whole process. */
+    auto allocation_count() -> std::size_t;
+
+    /** Counts global allocations made by every thread from construction onwards */
+    struct allocation_scope {
+        auto count() const -> std::size_t { return allocation_count() - start_; }
+
+    private:
+        std::size_t start_ = allocation_count();
+    };
+
+    /** A bag of latency samples, in nanoseconds.
+     * Each benchmark thread should own one recorder; recorders are merged once the thread has joined.
+     */
+    struct latency_recorder {
+
+        void reserve(std::size_t n) { samples_.reserve(n); }
+
+        void record(std::uint64_t ns) { samples_.push_back(ns); }
+
+        void record(clock_type::time_point first, clock_type::time_point last) {
+            record(nanoseconds_between(first, last));
+        }
+
+        void merge(latency_recorder const &other) {
+            samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+        }
+
+        auto size() const { return samples_.size(); }
+
+        /** Return the sample at the given quantile (0.0 - 1.0). The samples are sorted as a side effect. */
+        auto percentile(double q) -> std::uint64_t {
+            if (samples_.empty()) return 0;
+            std::sort(samples_.begin(), samples_.end());
+            auto index = static_cast<std::size_t>(q * (samples_.size() - 1) + 0.5);
+            return samples_[std::min(index, samples_.size() - 1)];
+        }
+
+    private:
+        std::vector<std::uint64_t> samples_;
+    };
+
+    /** The environment in which one benchmark runs.
+     * threads is the number of threads to devote to the run_pool of the io_service under test and, where it
+     * makes sense, the number of client threads driving the load.
+     */
+    struct context {
+        std::size_t threads = 1;
+        std::size_t iterations = 100000;
+
+        /** Print one line of results.
+         * @param allocations the number of global allocations made while running the ops, if measured
+         */
+        void report(std::string const &name, std::size_t ops, clock_type::duration elapsed, latency_recorder &latency,
+                    std::size_t allocations = not_measured) const {
+            auto seconds = std::chrono::duration<double>(elapsed).count();
+            auto ops_per_sec = seconds > 0 ? double(ops) / seconds : 0.0;
+            std::cout << std::left << std::setw(36) << name
+                      << std::right << std::setw(8) << threads
+                      << std::setw(12) << ops
+                      << std::setw(16) << std::fixed << std::setprecision(0) << ops_per_sec
+                      << std::setw(12) << latency.percentile(0.5)
+                      << std::setw(12) << latency.percentile(0.99)
+                      << std::setw(12) << latency.percentile(0.999);
+            if (allocations == not_measured or ops == 0) {
+                std::cout << std::setw(12) << "-";
+            } else {
+                std::cout << std::setw(12) << std::setprecision(2) << double(allocations) / double(ops);
+            }
+            std::cout << std::endl;
+        }
+
+        static constexpr std::size_t not_measured = ~std::size_t(0);
+    };
+
+    inline void print_header() {
+        std::cout << std::left << std::setw(36) << "benchmark"
+                  << std::right << std::setw(8) << "threads"
+                  << std::setw(12) << "ops"
+                  << std::setw(16) << "ops/sec"
+                  << std::setw(12) << "p50(ns)"
+                  << std::setw(12) << "p99(ns)"
+                  << std::setw(12) << "p99.9(ns)"
+                  << std::setw(12) << "allocs/op"
+                  << std::endl;
+    }
+
+    using benchmark_function = std::function<void(context const &)>;
+
+    struct benchmark {
+        std::string name;
+        benchmark_function function;
+    };
+
+    inline auto registry() -> std::vector<benchmark> & {
+        static std::vector<benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    /** Declare a static instance of this in a bench source file to make a benchmark available to tiggle-bench */
+    struct registrar {
+        registrar(std::string name, benchmark_function function) {
+            registry().push_back(benchmark{std::move(name), std::move(function)});
+        }
+    };
+
+    /** Run f(thread_index) on each of n threads and wait for them all.
+     * The threads are released together so that start-up cost is not measured.
+     */
+    template<class F>
+    void run_on_threads(std::size_t n, F &&f) {
+        std::vector<std::thread> threads;
+        threads.reserve(n);
+        std::atomic<bool> go{false};
+        for (std::size_t i = 0; i < n; ++i) {
+            threads.emplace_back([&f, &go, i] {
+                while (not go.load(std::memory_order_acquire)) std::this_thread::yield();
+                f(i);
+            });
+        }
+        go.store(true, std::memory_order_release);
+        for (auto &t : threads) t.join();
+    }
+
+    /** Spin until the predicate is true */
+    template<class Pred>
+    void spin_until(Pred &&pred) {
+        while (not pred()) std::this_thread::yield();
+    }
+}
@@ -0,0 +1,115 @@
+#include "bench_harness.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+// count every allocation in the process so that benchmarks can report allocations per operation
+
+namespace {
+    std::atomic<std::size_t> global_allocations{0};
+}
+
+auto bench::allocation_count() -> std::size_t {
+    return global_allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size) {
+    global_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+    auto parse_thread_counts(std::string const &arg) -> std::vector<std::size_t> {
+        std::vector<std::size_t> result;
+        std::istringstream is(arg);
+        std::string item;
+        while (std::getline(is, item, ',')) {
+            if (not item.empty()) result.push_back(std::stoul(item));
+        }
+        return result;
+    }
+
+    auto default_thread_counts() -> std::vector<std::size_t> {
+        auto max_threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+        std::vector<std::size_t> result;
+        for (std::size_t n = 1; n < max_threads; n *= 2) {
+            result.push_back(n);
+        }
+        result.push_back(max_threads);
+        return result;
+    }
+
+    bool starts_with(std::string const &s, std::string const &prefix) {
+        return s.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    void usage(char const *argv0) {
+        std::cerr << "usage: " << argv0 << " [--threads=1,2,4] [--iterations=N] [filter...]\n"
+                  << "  runs every benchmark whose name contains one of the filters (all if none given)\n"
+                  << "  benchmarks:\n";
+        for (auto const &b : bench::registry()) {
+            std::cerr << "    " << b.name << "\n";
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+
+    auto thread_counts = default_thread_counts();
+    std::size_t iterations = bench::context().iterations;
+    std::vector<std::string> filters;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (starts_with(arg, "--threads=")) {
+            thread_counts = parse_thread_counts(arg.substr(10));
+        } else if (starts_with(arg, "--iterations=")) {
+            iterations = std::stoul(arg.substr(13));
+        } else if (arg == "--help" or arg == "-h") {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else {
+            filters.push_back(arg);
+        }
+    }
+
+    auto selected = [&](bench::benchmark const &b) {
+        return filters.empty() or std::any_of(filters.begin(), filters.end(), [&](auto const &f) {
+            return b.name.find(f) != std::string::npos;
+        });
+    };
+
+    bench::print_header();
+    for (auto const &b : bench::registry()) {
+        if (not selected(b)) continue;
+        for (auto threads : thread_counts) {
+            bench::context ctx;
+            ctx.threads = threads;
+            ctx.iterations = iterations;
+            b.function(ctx);
+        }
+    }
+}
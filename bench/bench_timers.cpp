@@ -0,0 +1,106 @@
+#include "bench_harness.hpp"
+
+#include "config.hpp"
+#include "run_pool.hpp"
+#include "timing_wheel_service.hpp"
+
+#include <boost/asio/steady_timer.hpp>
+#include <memory>
+
+namespace {
+
+    /** The cost of arming and cancelling one timer while a large population of other timers is pending,
+     * as happens when a goblin is born and then killed in a horde of KillingFolk.
+     */
+    template<class Timer, class Arm>
+    void schedule_cancel(bench::context const &ctx, std::string const &name, Arm arm) {
+        for (std::size_t population : {1000, 100000}) {
+            asio::io_service executor;
+            run_pool pool{executor, "bench"};
+            for (std::size_t i = 0; i < ctx.threads; ++i) pool.add_thread();
+
+            std::vector<std::unique_ptr<Timer>> standing;
+            standing.reserve(population);
+            for (std::size_t i = 0; i < population; ++i) {
+                standing.push_back(std::make_unique<Timer>(executor));
+                arm(*standing.back(), std::chrono::seconds(60));
+            }
+
+            auto per_thread = std::max<std::size_t>(1, ctx.iterations / ctx.threads);
+            std::vector<bench::latency_recorder> latencies(ctx.threads);
+            for (auto &latency : latencies) latency.reserve(per_thread);
+
+            bench::allocation_scope allocations;
+            auto start = bench::clock_type::now();
+            bench::run_on_threads(ctx.threads, [&](std::size_t t) {
+                Timer timer(executor);
+                for (std::size_t i = 0; i < per_thread; ++i) {
+                    auto t0 = bench::clock_type::now();
+                    arm(timer, std::chrono::seconds(5));
+                    timer.cancel();
+                    latencies[t].record(t0, bench::clock_type::now());
+                }
+            });
+            auto elapsed = bench::clock_type::now() - start;
+
+            for (std::size_t t = 1; t < ctx.threads; ++t) latencies[0].merge(latencies[t]);
+            ctx.report(name + "/" + std::to_string(population), per_thread * ctx.threads, elapsed, latencies[0],
+                       allocations.count());
+
+            for (auto &timer : standing) timer->cancel();
+            standing.clear();
+            pool.stop();
+        }
+    }
+
+    void wheel_schedule_cancel(bench::context const &ctx) {
+        schedule_cancel<wheel_timer>(ctx, "timer/wheel", [](wheel_timer &timer, auto d) {
+            timer.async_wait_for(d, [] {});
+        });
+    }
+
+    void asio_schedule_cancel(bench::context const &ctx) {
+        schedule_cancel<asio::steady_timer>(ctx, "timer/asio", [](asio::steady_timer &timer, auto d) {
+            timer.expires_from_now(d);
+            timer.async_wait([](asio::error_code const &) {});
+        });
+    }
+
+    /** Many timers all due at about the same time: how quickly does the wheel fire them in batches? */
+    void wheel_expiry(bench::context const &ctx) {
+        asio::io_service executor;
+        run_pool pool{executor, "bench"};
+        for (std::size_t i = 0; i < ctx.threads; ++i) pool.add_thread();
+
+        auto count = ctx.iterations;
+        std::vector<std::unique_ptr<wheel_timer>> timers;
+        timers.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            timers.push_back(std::make_unique<wheel_timer>(executor));
+        }
+
+        std::atomic<std::size_t> fired{0};
+        bench::latency_recorder lateness;
+        lateness.reserve(count);
+        std::vector<std::uint64_t> late_by(count);
+
+        auto due = bench::clock_type::now() + std::chrono::milliseconds(50);
+        for (std::size_t i = 0; i < count; ++i) {
+            timers[i]->async_wait_for(due - bench::clock_type::now(), [&, i, due] {
+                auto now = bench::clock_type::now();
+                late_by[i] = now > due ? bench::nanoseconds_between(due, now) : 0;
+                fired.fetch_add(1);
+            });
+        }
+        bench::spin_until([&] { return fired.load() == count; });
+        auto elapsed = bench::clock_type::now() - due;
+        for (auto ns : late_by) lateness.record(ns);
+
+        ctx.report("timer/wheel/expiry", count, elapsed, lateness);
+        pool.stop();
+    }
+
+    bench::registrar wheel_registrar("timer/wheel", wheel_schedule_cancel);
+    bench::registrar asio_registrar("timer/asio", asio_schedule_cancel);
+    bench::registrar expiry_registrar("timer/wheel/expiry", wheel_expiry);
+}
@@ -0,0 +1,4 @@
+sugar_files(BENCH_SOURCES bench_harness.hpp
+        bench_main.cpp
+        bench_goblins.cpp
+        bench_timers.cpp)
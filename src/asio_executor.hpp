@@ -0,0 +1,30 @@
+#pragma once
+
+#include "config.hpp"
+
+template<class AsioExecutor>
+struct asio_executor {
+    asio_executor(AsioExecutor &exec) : executor_(exec) {}
+
+    void close() { executor_.stop(); }
+
+    bool closed() { return executor_.stopped(); }
+
+    template<class Closure>
+    void submit(Closure &&closure) {
+        executor_.dispatch(std::forward<Closure>(closure));
+    }
+
+    bool try_executing_one() {
+        auto ran = executor_.poll_one();
+        return ran != 0;
+    }
+
+private:
+    AsioExecutor &executor_;
+};
+
+template<class AsioExecutor>
+auto make_asio_executor(AsioExecutor &exec) {
+    return asio_executor<AsioExecutor>(exec);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <boost/asio/detail/handler_alloc_helpers.hpp>
+#include <boost/asio/detail/handler_cont_helpers.hpp>
+#include <boost/asio/detail/handler_invoke_helpers.hpp>
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/** A completion handler bound to the arguments it will be called with, ready to be posted.
+ * asio's allocation, invocation and continuation hooks are forwarded to the wrapped handler.
+ */
+template<class Handler, class...Args>
+struct bound_completion {
+    template<class...Ts>
+    bound_completion(Handler handler, Ts &&...args)
+            : handler_(std::move(handler)), args_(std::forward<Ts>(args)...) {}
+
+    void operator()() {
+        invoke(std::index_sequence_for<Args...>());
+    }
+
+    friend void *asio_handler_allocate(std::size_t size, bound_completion *self) {
+        return boost_asio_handler_alloc_helpers::allocate(size, self->handler_);
+    }
+
+    friend void asio_handler_deallocate(void *p, std::size_t size, bound_completion *self) {
+        boost_asio_handler_alloc_helpers::deallocate(p, size, self->handler_);
+    }
+
+    template<class Function>
+    friend void asio_handler_invoke(Function &&function, bound_completion *self) {
+        boost_asio_handler_invoke_helpers::invoke(function, self->handler_);
+    }
+
+    friend bool asio_handler_is_continuation(bound_completion *self) {
+        return boost_asio_handler_cont_helpers::is_continuation(self->handler_);
+    }
+
+private:
+    template<std::size_t...Is>
+    void invoke(std::index_sequence<Is...>) {
+        handler_(std::move(std::get<Is>(args_))...);
+    }
+
+    Handler handler_;
+    std::tuple<Args...> args_;
+};
+
+/** The handler which goblin_service gives a goblin in place of the user's completion handler.
+ *
+ * Calling it posts the user's handler, bound to the call's arguments, through the Scheduler (anything with a
+ * post() member). The user's handler is moved, never copied, so it may be called only once. Until then it keeps
+ * the io_service on which the handler will run from running out of work.
+ */
+template<class Handler, class Scheduler>
+struct async_completion_handler {
+    async_completion_handler(Scheduler &scheduler, asio::io_service &executor, Handler handler)
+            : scheduler_(std::addressof(scheduler)), work_(executor), handler_(std::move(handler)) {}
+
+    // copying the work object only increments a counter, so moving is as cheap as moving the handler
+    async_completion_handler(async_completion_handler &&other)
+    noexcept(std::is_nothrow_move_constructible<Handler>::value)
+            : scheduler_(other.scheduler_), work_(other.work_), handler_(std::move(other.handler_)) {}
+
+    async_completion_handler(async_completion_handler const &) = delete;
+
+    async_completion_handler &operator=(async_completion_handler const &) = delete;
+
+    template<class...Args>
+    void operator()(Args &&...args) {
+        scheduler_->post(bound_completion<Handler, std::decay_t<Args>...>(std::move(handler_),
+                                                                          std::forward<Args>(args)...));
+    }
+
+    friend void *asio_handler_allocate(std::size_t size, async_completion_handler *self) {
+        return boost_asio_handler_alloc_helpers::allocate(size, self->handler_);
+    }
+
+    friend void asio_handler_deallocate(void *p, std::size_t size, async_completion_handler *self) {
+        boost_asio_handler_alloc_helpers::deallocate(p, size, self->handler_);
+    }
+
+private:
+    Scheduler *scheduler_;
+    asio::io_service::work work_;
+    Handler handler_;
+};
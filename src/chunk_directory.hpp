@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/** Up to MaxChunks fixed-size chunks of a basic_slot_map or goblin_world, by chunk number.
+ *
+ * The directory has two levels, so that only its top level, of one pointer per page_size chunks, is allocated up
+ * front. A page of page_size chunk pointers is allocated with the first chunk which falls in it. Chunks and pages
+ * are never moved or freed while the directory exists, so a chunk already added can be looked up without a lock.
+ * Adding chunks must be serialised by the owner.
+ */
+template<class Chunk, std::size_t MaxChunks>
+class chunk_directory {
+public:
+    static constexpr std::size_t page_size = 256;
+    static constexpr std::size_t page_count = (MaxChunks + page_size - 1) / page_size;
+
+    chunk_directory() = default;
+
+    chunk_directory(chunk_directory const &) = delete;
+
+    chunk_directory &operator=(chunk_directory const &) = delete;
+
+    ~chunk_directory() {
+        for (auto &entry : pages_) {
+            auto page = entry.load(std::memory_order_relaxed);
+            if (not page) continue;
+            for (auto &chunk : page->chunks) delete chunk.load(std::memory_order_relaxed);
+            delete page;
+        }
+    }
+
+    /** Chunk n, which must have been added */
+    auto operator[](std::size_t n) const -> Chunk & {
+        auto page = pages_[n / page_size].load(std::memory_order_acquire);
+        return *page->chunks[n % page_size].load(std::memory_order_acquire);
+    }
+
+    /** Allocate chunk n, which must not exist yet and must be less than MaxChunks */
+    void add(std::size_t n) {
+        auto &entry = pages_[n / page_size];
+        auto page = entry.load(std::memory_order_relaxed);
+        if (not page) {
+            page = new page_type();
+            entry.store(page, std::memory_order_release);
+        }
+        page->chunks[n % page_size].store(new Chunk(), std::memory_order_release);
+    }
+
+private:
+    struct page_type {
+        std::atomic<Chunk *> chunks[page_size] = {};
+    };
+
+    std::atomic<page_type *> pages_[page_count] = {};
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "config.hpp"
+#include "async_completion_handler.hpp"
+#include "unique_handler.hpp"
+#include "work_stealing_service.hpp"
+
+#include <boost/container/small_vector.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/** A handler waiting for a goblin, which a completion_batch will complete along with any others.
+ *
+ * A waiter made with a scheduler is run through that scheduler, as if by post(): on its own if it is the only
+ * one, otherwise by one task for the whole batch, in which case the user's handler is called through its own
+ * asio_handler_invoke hook, so that a strand-wrapped handler still runs in its strand. Until then it counts as
+ * outstanding work of the scheduler, so the io_service does not run out of work while it waits. A waiter made
+ * without a scheduler is called directly by whoever dispatches the batch.
+ */
+class goblin_waiter {
+public:
+    goblin_waiter() noexcept = default;
+
+    template<class Handler, class = std::enable_if_t<not std::is_same<std::decay_t<Handler>, goblin_waiter>::value>>
+    goblin_waiter(Handler &&handler)
+            : handler_(calling<std::decay_t<Handler>>(std::forward<Handler>(handler))) {}
+
+    template<class Handler>
+    goblin_waiter(work_stealing_service &scheduler, Handler &&handler)
+            : scheduler_(std::addressof(scheduler)),
+              handler_(scheduled<std::decay_t<Handler>>(scheduler, std::forward<Handler>(handler))) {}
+
+    explicit operator bool() const noexcept { return bool(handler_); }
+
+    /** Call the handler now, on this thread */
+    void operator()(asio::error_code const &ec) {
+        handler_(ec, false);
+    }
+
+    /** Post the handler through its scheduler, or call it now if it has none */
+    void post(asio::error_code const &ec) {
+        handler_(ec, true);
+    }
+
+    /** The scheduler which must run the handler, or nullptr if it may be called directly */
+    auto scheduler() const -> work_stealing_service * { return scheduler_; }
+
+private:
+    template<class Handler>
+    struct calling {
+        explicit calling(Handler handler) : handler(std::move(handler)) {}
+
+        void operator()(asio::error_code const &ec, bool) {
+            handler(ec);
+        }
+
+        Handler handler;
+    };
+
+    /** One unit of the scheduler's outstanding work, given back when the waiter is destroyed */
+    struct outstanding_work {
+        explicit outstanding_work(work_stealing_service &scheduler) : scheduler(std::addressof(scheduler)) {
+            scheduler.work_started();
+        }
+
+        outstanding_work(outstanding_work &&other) noexcept : scheduler(other.scheduler) {
+            other.scheduler = nullptr;
+        }
+
+        outstanding_work &operator=(outstanding_work &&) = delete;
+
+        ~outstanding_work() {
+            if (scheduler) scheduler->work_finished();
+        }
+
+        work_stealing_service *scheduler;
+    };
+
+    template<class Handler>
+    struct scheduled {
+        scheduled(work_stealing_service &scheduler, Handler handler)
+                : scheduler(std::addressof(scheduler)), work(scheduler), handler(std::move(handler)) {}
+
+        void operator()(asio::error_code const &ec, bool post) {
+            auto bound = bound_completion<Handler, asio::error_code>(std::move(handler), ec);
+            if (post) {
+                scheduler->post(std::move(bound));
+            } else {
+                boost_asio_handler_invoke_helpers::invoke(bound, bound);
+            }
+        }
+
+        friend void *asio_handler_allocate(std::size_t size, scheduled *self) {
+            return boost_asio_handler_alloc_helpers::allocate(size, self->handler);
+        }
+
+        friend void asio_handler_deallocate(void *p, std::size_t size, scheduled *self) {
+            boost_asio_handler_alloc_helpers::deallocate(p, size, self->handler);
+        }
+
+        work_stealing_service *scheduler;
+        outstanding_work work;
+        Handler handler;
+    };
+
+    work_stealing_service *scheduler_ = nullptr;
+    unique_handler<void(asio::error_code const &, bool)> handler_;
+};
+
+/** Completions collected while a goblin's mutex is held, to be dispatched once it has been released.
+ *
+ * dispatch() posts one task per scheduler, however many waiters are bound for it. The waiters keep their
+ * scheduler's outstanding work until that task has completed them.
+ */
+class completion_batch {
+public:
+    completion_batch() = default;
+
+    completion_batch(completion_batch &&other)
+            : entries_(std::move(other.entries_)) {
+        other.entries_.clear();
+    }
+
+    completion_batch &operator=(completion_batch &&other) {
+        dispatch();
+        entries_ = std::move(other.entries_);
+        other.entries_.clear();
+        return *this;
+    }
+
+    ~completion_batch() {
+        dispatch();
+    }
+
+    void add(goblin_waiter waiter, asio::error_code const &ec) {
+        entries_.emplace_back(std::move(waiter), ec);
+    }
+
+    /** Take on every completion of another batch, to be dispatched with these */
+    void append(completion_batch &&other) {
+        for (auto &e : other.entries_) entries_.push_back(std::move(e));
+        other.entries_.clear();
+    }
+
+    bool empty() const { return entries_.empty(); }
+
+    auto size() const -> std::size_t { return entries_.size(); }
+
+    /** Run or post every completion, then forget them */
+    void dispatch() {
+        if (entries_.empty()) return;
+        auto entries = std::move(entries_);
+        entries_.clear();
+
+        // nearly always every waiter is bound for the same scheduler, so this is one pass
+        for (auto first = entries.begin(); first != entries.end(); ++first) {
+            if (not first->first) continue;
+            auto scheduler = first->first.scheduler();
+            auto same = [scheduler](entry const &e) { return e.first and e.first.scheduler() == scheduler; };
+            if (not scheduler or std::count_if(first, entries.end(), same) == 1) {
+                // nothing to share, so the handler is posted, or called, as it is
+                auto waiter = std::move(first->first);
+                waiter.post(first->second);
+                continue;
+            }
+            auto group = std::make_shared<entries_type>();
+            for (auto it = first; it != entries.end(); ++it) {
+                if (same(*it)) group->push_back(std::move(*it));
+            }
+            post_group(*scheduler, std::move(group));
+        }
+    }
+
+private:
+    using entry = std::pair<goblin_waiter, asio::error_code>;
+    using entries_type = boost::container::small_vector<entry, 1>;
+
+    static void complete(entry &e) {
+        auto waiter = std::move(e.first);
+        waiter(e.second);
+    }
+
+    // shared, because the io_service may copy the handlers posted to it
+    static void post_group(work_stealing_service &scheduler, std::shared_ptr<entries_type> group) {
+        scheduler.post([group = std::move(group)] {
+            for (auto &e : *group) complete(e);
+        });
+    }
+
+    entries_type entries_;
+};
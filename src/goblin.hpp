@@ -0,0 +1,254 @@
+#pragma once
+
+#include "config.hpp"
+#include "goblin_service.hpp"
+
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+/** This is a goblin.
+ * A goblin lives in an io_service.
+ * A goblin has an automatically generated name
+ * A goblin will do nothing until it is told to start_killing
+ * Then it will kill people at random until it is killed.
+ * It will report to any interested listeners that it has killed someone or it has died.
+ */
+template<class Outer>
+struct goblin_interface {
+    template<class Handler>
+    auto async_spawn(Handler &&handler) {
+        auto self = outer_self();
+        return self->get_service().async_spawn(self->get_implementation(),
+                                               std::forward<Handler>(handler));
+    }
+
+    /** Lock-free and allocation-free. The name is immutable, so the handle may be kept as long as required. */
+    auto name() const -> goblin_name {
+        auto self = outer_self();
+        return self->get_service().name(self->get_implementation());
+    }
+
+    /** Wait-free. The answer may be out of date by the time the caller sees it. */
+    bool is_dead() const {
+        auto self = outer_self();
+        return self->get_service().is_dead(self->get_implementation());
+    }
+
+    /** Wait-free. The answer may be out of date by the time the caller sees it. */
+    auto current_state() const -> goblin_state_id {
+        auto self = outer_self();
+        return self->get_service().current_state(self->get_implementation());
+    }
+
+    /** Wait-free. Everything in the snapshot was true at the same moment. */
+    auto snapshot() const -> goblin_snapshot {
+        auto self = outer_self();
+        return self->get_service().snapshot(self->get_implementation());
+    }
+
+    void be_born() {
+        auto self = outer_self();
+        self->get_service().be_born(self->get_implementation());
+    }
+
+    void die() {
+        auto self = outer_self();
+        self->get_service().die(self->get_implementation());
+    }
+
+private:
+    Outer *outer_self() { return static_cast<Outer *>(this); }
+
+    const Outer *outer_self() const { return static_cast<const Outer *>(this); }
+};
+
+/** A reference to a goblin, which does not own it.
+ * It is a generational handle into the goblin_service's slot map, so copying one, or passing it to another thread,
+ * touches no shared state. Each call pins the goblin for its duration. Once the goblin has been destroyed the
+ * reference is stale, and reads as a goblin which was stopped before it was born (see goblin_service).
+ */
+struct goblin_ref : goblin_interface<goblin_ref> {
+    using service_type = goblin_service;
+    using implementation_type = goblin_handle;
+
+    goblin_ref(service_type &service, goblin_handle handle)
+            : service_(std::addressof(service)),
+              impl_(handle) {}
+
+    /** Whether the goblin still exists. The answer may be out of date by the time the caller sees it. */
+    bool valid() const {
+        return get_service().contains(impl_);
+    }
+
+    auto get_implementation() -> implementation_type & {
+        return impl_;
+    }
+
+    auto get_implementation() const -> implementation_type const & {
+        return impl_;
+    }
+
+    auto get_service() const -> service_type & {
+        return *service_;
+    }
+
+    auto get_executor() const -> asio::io_service & {
+        return get_service().get_io_service();
+    }
+
+
+private:
+    service_type *service_;
+    implementation_type impl_;
+
+};
+
+static_assert(std::is_trivially_copyable<goblin_ref>::value, "a goblin_ref must be free to copy");
+
+struct goblin : goblin_interface<goblin> {
+    using service_type = goblin_service;
+    using implementation_type = goblin_service::implementation_type;
+
+    goblin(asio::io_service &owner) :
+            service_(std::addressof(asio::use_service<service_type>(owner))),
+            impl_(get_service().construct()) {}
+
+    template<class WaitHandler>
+    goblin(asio::io_service &owner, WaitHandler &&handler) :
+            service_(std::addressof(asio::use_service<service_type>(owner))),
+            impl_(get_service().construct()) {
+
+        get_service().on_birth(get_implementation(), std::forward<WaitHandler>(handler));
+        be_born();
+    }
+
+    /** Take charge of an implementation made by goblin_service::construct_n */
+    goblin(service_type &service, implementation_type impl)
+            : service_(std::addressof(service)), impl_(std::move(impl)) {}
+
+    operator goblin_ref() const {
+        return goblin_ref(get_service(), get_implementation()->handle());
+    }
+
+    auto ref() const {
+        return goblin_ref(*this);
+    }
+
+    // allow goblins to be privately, - don't store copies in client code
+private:
+    goblin(goblin const &r)
+            : service_(r.service_), impl_(r.get_implementation()->shared_from_this()) {}
+
+    goblin &operator=(goblin const &) = delete;
+
+public:
+    goblin(goblin &&) = default;
+
+    goblin &operator=(goblin &&) = default;
+
+    ~goblin() = default;
+
+    /** compare two goblins for equality.
+     * Two goblins are considered equal if they reference the same internal goblin state.
+     * Two goblin states that happen to share a name are not equal.
+     * A goblin copy is not equal to its parent if the parent has been moved from.
+     * @return
+     */
+    bool operator==(goblin const &r) const {
+        return get_implementation().get() == r.get_implementation().get();
+    }
+
+    // boilerplate
+
+
+    auto get_service() const -> service_type & {
+        return *service_;
+    }
+
+    auto get_executor() const -> asio::io_service & {
+        return get_service().get_io_service();
+    }
+
+
+    /** Request the goblin to call a handler when born.
+     * The handler shall be called exactly once, as if by a call to get_executor().post().
+     * The handler will be invoked with the signature void(goblin&). The handler may use the
+     * goblin reference to perform gobliny actions but should not seek to store or copy it as it
+     * maintains a shared reference to the internal goblin state
+     * @tparam Handler
+     * @param handler
+     * @return
+     */
+    template<class Handler>
+    auto on_birth(Handler &&handler) {
+        return get_service().on_birth(get_implementation(), std::forward<Handler>(handler));
+    }
+
+    /** Request the goblin to call a handler when it dies (or if it's already dead).
+     * The handler shall be called exactly once, as if by a call to get_executor().post().
+     * The handler will be invoked with the signature void(goblin&). The handler may use the
+     * goblin reference to perform gobliny actions but should not seek to store or copy it as it
+     * maintains a shared reference to the internal goblin state
+     * @tparam Handler
+     * @param handler
+     * @return
+     */
+
+    template<class WaitHandler>
+    auto wait_death(WaitHandler &&handler) {
+        // If you get an error on the following line it means that your handler does
+        // not meet the documented type requirements for a WaitHandler.
+        //BOOST_ASIO_WAIT_HANDLER_CHECK(WaitHandler, handler) type_check;
+
+        return get_service().wait_death(get_implementation(),
+                                        std::forward<WaitHandler>(handler));
+    }
+
+
+    auto get_implementation() -> implementation_type & {
+        return impl_;
+    }
+
+    auto get_implementation() const -> implementation_type const & {
+        return impl_;
+    }
+
+private:
+    service_type *service_;
+    implementation_type impl_;
+};
+
+/** Construct count goblins in the io_service at once. See goblin_service::construct_n. */
+inline auto make_goblins(asio::io_service &owner, std::size_t count) -> std::vector<goblin> {
+    auto &service = asio::use_service<goblin_service>(owner);
+    auto impls = service.construct_n(count);
+    std::vector<goblin> result;
+    result.reserve(count);
+    for (auto &impl : impls) {
+        result.emplace_back(service, std::move(impl));
+    }
+    return result;
+}
+
+/** Give birth to every goblin in a range. See goblin_service::spawn_all. */
+template<class Range>
+void spawn_all(Range &goblins) {
+    using std::begin;
+    using std::end;
+    auto first = begin(goblins);
+    auto last = end(goblins);
+    if (first == last) return;
+    first->get_service().spawn_all(first, last);
+}
+
+/** Kill every goblin in a range. See goblin_service::die_all. */
+template<class Range>
+void die_all(Range &goblins) {
+    using std::begin;
+    using std::end;
+    auto first = begin(goblins);
+    auto last = end(goblins);
+    if (first == last) return;
+    first->get_service().die_all(first, last);
+}
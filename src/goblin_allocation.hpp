@@ -0,0 +1,97 @@
+#pragma once
+
+#include "impl_proxy.hpp"
+#include "slab_pool.hpp"
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/** One slab_pool block holding an implementation, the impl_proxy which controls it and the shared_ptr control
+ * block of that proxy.
+ *
+ * The block itself is owned by a shared_ptr created with allocate_shared, so the implementation's
+ * enable_shared_from_this still works. The proxy is created in place afterwards; its control block is placed in
+ * the reserved storage by pooled_proxy_allocator, which keeps the block's storage, but not the implementation,
+ * until the last weak reference to the proxy has gone.
+ */
+template<class Implementation>
+struct pooled_goblin_block : Implementation {
+    using proxy_type = impl_proxy<Implementation>;
+
+    static constexpr std::size_t control_block_capacity = 64;
+
+    template<class...Args>
+    pooled_goblin_block(Args &&...args)
+            : Implementation(std::forward<Args>(args)...) {}
+
+    auto proxy_address() -> void * { return std::addressof(proxy_storage_); }
+
+    auto control_block_address() -> void * { return std::addressof(control_block_storage_); }
+
+private:
+    std::aligned_storage_t<sizeof(proxy_type), alignof(proxy_type)> proxy_storage_;
+    std::aligned_storage_t<control_block_capacity, alignof(std::max_align_t)> control_block_storage_;
+};
+
+/** Allocates the proxy's control block inside its pooled_goblin_block, falling back to the slab_pool should the
+ * standard library's control block not fit. Holds only a weak reference to the block: allocate_shared frees the
+ * storage with the last weak reference, so the control block stays in place without keeping the implementation
+ * alive, and a destroyed goblin still remembered by a weak_ptr holds its memory but nothing else.
+ */
+template<class T, class Block>
+struct pooled_proxy_allocator {
+    using value_type = T;
+
+    explicit pooled_proxy_allocator(std::shared_ptr<Block> const &block) noexcept
+            : block_(block), control_block_(block->control_block_address()) {}
+
+    template<class U>
+    pooled_proxy_allocator(pooled_proxy_allocator<U, Block> const &other) noexcept
+            : block_(other.block_), control_block_(other.control_block_) {}
+
+    auto allocate(std::size_t n) -> T * {
+        if (fits_in_block(n)) {
+            return static_cast<T *>(control_block_);
+        }
+        return static_cast<T *>(slab_pool::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        if (static_cast<void *>(p) != control_block_) {
+            slab_pool::deallocate(p, n * sizeof(T));
+        }
+    }
+
+    template<class U>
+    bool operator==(pooled_proxy_allocator<U, Block> const &r) const noexcept {
+        return control_block_ == r.control_block_;
+    }
+
+    template<class U>
+    bool operator!=(pooled_proxy_allocator<U, Block> const &r) const noexcept {
+        return control_block_ != r.control_block_;
+    }
+
+    std::weak_ptr<Block> block_;
+    void *control_block_;
+
+private:
+    static bool fits_in_block(std::size_t n) {
+        return n * sizeof(T) <= Block::control_block_capacity and alignof(T) <= alignof(std::max_align_t);
+    }
+};
+
+/** Construct an implementation and its proxy in a single pooled block.
+ * @return a shared pointer whose lifetime is the lifetime of the proxy.
+ */
+template<class Implementation, class...Args>
+auto make_pooled_proxy(Args &&...args) -> std::shared_ptr<impl_proxy<Implementation>> {
+    using block_type = pooled_goblin_block<Implementation>;
+    using proxy_type = typename block_type::proxy_type;
+
+    auto block = std::allocate_shared<block_type>(pooled_allocator<block_type>(), std::forward<Args>(args)...);
+    auto proxy = ::new(block->proxy_address()) proxy_type(block);
+    auto destroy = [](proxy_type *p) { p->~proxy_type(); };
+    return std::shared_ptr<proxy_type>(proxy, destroy, pooled_proxy_allocator<proxy_type, block_type>(block));
+}
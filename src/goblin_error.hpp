@@ -10,6 +10,8 @@
 
 enum class goblin_error {
     actually_dead = 1,
+    host_lost = 2,
+    foreign_error = 3,
 };
 
 
@@ -18,7 +20,12 @@ struct goblin_category_def : boost::system::error_category {
         switch (static_cast<goblin_error>(ev)) {
             case goblin_error::actually_dead:
                 return "this goblin is actually dead";
+            case goblin_error::host_lost:
+                return "the process hosting this goblin has gone away";
+            case goblin_error::foreign_error:
+                return "the process hosting this goblin reported an error it could not pass on";
         }
+        return "unknown goblin error";
     }
 
     const char *name() const noexcept override {
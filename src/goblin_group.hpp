@@ -0,0 +1,89 @@
+#pragma once
+
+#include "config.hpp"
+#include "goblin.hpp"
+#include "goblin_group_state.hpp"
+
+#include <memory>
+
+/** A set of goblins which can be waited for as a whole.
+ *
+ * Each member reports its birth and death to the group by updating a counter, and a wait completes when the
+ * counter it depends on reaches zero. Waiting for a horde of any size therefore costs one handler, not one per
+ * goblin.
+ *
+ * A member destroyed before it is born or dies counts as both: it will never be born, and it is no longer alive.
+ * Members should be added before waiting. A wait for all_born or all_dead on an empty group completes at once.
+ */
+class goblin_group {
+public:
+    explicit goblin_group(asio::io_service &owner)
+            : service_(std::addressof(asio::use_service<goblin_service>(owner))),
+              state_(std::make_shared<detail::group_state>()) {}
+
+    goblin_group(goblin_group const &) = delete;
+
+    goblin_group &operator=(goblin_group const &) = delete;
+
+    /** Outstanding waits are completed with operation_aborted */
+    ~goblin_group() {
+        completion_batch completions;
+        state_->close(completions);
+    }
+
+    /** Add a goblin, given by a goblin or a goblin_ref */
+    template<class Handle>
+    void add(Handle const &member) {
+        service_->join_group(member.get_implementation(), state_);
+    }
+
+    template<class Iterator>
+    void add(Iterator first, Iterator last) {
+        for (; first != last; ++first) add(*first);
+    }
+
+    auto size() const -> std::size_t { return state_->size(); }
+
+    /** The number of members which are neither dead nor destroyed. The answer may be out of date at once. */
+    auto alive() const -> std::size_t { return state_->alive(); }
+
+    /** Wait until every member has been born. The handler has the signature void(asio::error_code). */
+    template<class Handler>
+    auto async_wait_all_born(Handler &&handler) {
+        return async_wait(goblin_group_condition::all_born, std::forward<Handler>(handler));
+    }
+
+    /** Wait until every member is dead */
+    template<class Handler>
+    auto async_wait_all_dead(Handler &&handler) {
+        return async_wait(goblin_group_condition::all_dead, std::forward<Handler>(handler));
+    }
+
+    /** Wait until at least one member is dead */
+    template<class Handler>
+    auto async_wait_any_dead(Handler &&handler) {
+        return async_wait(goblin_group_condition::any_dead, std::forward<Handler>(handler));
+    }
+
+    auto get_executor() const -> asio::io_service & {
+        return service_->get_io_service();
+    }
+
+private:
+    template<class Handler>
+    auto async_wait(goblin_group_condition condition, Handler &&handler) {
+
+        asio::detail::async_result_init<
+                Handler, void(boost::system::error_code)> init(
+                std::forward<Handler>(handler));
+
+        completion_batch completions;
+        state_->wait(condition, service_->make_waiter(std::move(init.handler)), completions);
+        completions.dispatch();
+
+        return init.result.get();
+    }
+
+    goblin_service *service_;
+    std::shared_ptr<detail::group_state> state_;
+};
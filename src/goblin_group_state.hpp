@@ -0,0 +1,111 @@
+#pragma once
+
+#include "config.hpp"
+#include "completion_batch.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/** What a goblin_group can wait for */
+enum class goblin_group_condition {
+    all_born,
+    all_dead,
+    any_dead,
+};
+
+namespace detail {
+
+    /** The shared state of a goblin_group: three counters, which members update as they are born and die, and
+     * the handlers waiting for them.
+     *
+     * A member's transition costs one atomic operation on each counter it affects. The mutex is taken only to add
+     * a waiter, and by the transition which makes a condition true, to complete the waiters.
+     */
+    class group_state {
+    public:
+        /** Count a new member. born: it has been born, or will never be. dead: it is dead already. */
+        void member_joined(bool born, bool dead) {
+            members_.fetch_add(1, std::memory_order_relaxed);
+            if (not born) unborn_.fetch_add(1, std::memory_order_acq_rel);
+            if (dead) {
+                dead_.fetch_add(1, std::memory_order_acq_rel);
+            } else {
+                alive_.fetch_add(1, std::memory_order_acq_rel);
+            }
+        }
+
+        void member_born(completion_batch &completions) {
+            if (unborn_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                fire(goblin_group_condition::all_born, completions);
+            }
+        }
+
+        void member_died(completion_batch &completions) {
+            if (dead_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+                fire(goblin_group_condition::any_dead, completions);
+            }
+            if (alive_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                fire(goblin_group_condition::all_dead, completions);
+            }
+        }
+
+        /** Add the waiter's completion to completions if the condition is true now, otherwise keep it until it is */
+        void wait(goblin_group_condition condition, goblin_waiter waiter, completion_batch &completions) {
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            if (closed_) {
+                completions.add(std::move(waiter), asio::error::operation_aborted);
+            } else if (holds(condition)) {
+                completions.add(std::move(waiter), asio::error_code());
+            } else {
+                waiters_[std::size_t(condition)].push_back(std::move(waiter));
+            }
+        }
+
+        /** Abort every waiter, now and in future */
+        void close(completion_batch &completions) {
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            closed_ = true;
+            for (auto &list : waiters_) {
+                for (auto &waiter : list) completions.add(std::move(waiter), asio::error::operation_aborted);
+                list.clear();
+            }
+        }
+
+        auto size() const -> std::size_t { return members_.load(std::memory_order_relaxed); }
+
+        auto alive() const -> std::size_t { return alive_.load(std::memory_order_acquire); }
+
+    private:
+        bool holds(goblin_group_condition condition) const {
+            switch (condition) {
+                case goblin_group_condition::all_born:
+                    return unborn_.load(std::memory_order_acquire) == 0;
+                case goblin_group_condition::all_dead:
+                    return alive_.load(std::memory_order_acquire) == 0;
+                case goblin_group_condition::any_dead:
+                    return dead_.load(std::memory_order_acquire) != 0;
+            }
+            return false;
+        }
+
+        void fire(goblin_group_condition condition, completion_batch &completions) {
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            // a member may have joined since the count reached zero
+            if (not holds(condition)) return;
+            auto &list = waiters_[std::size_t(condition)];
+            for (auto &waiter : list) completions.add(std::move(waiter), asio::error_code());
+            list.clear();
+        }
+
+        std::atomic<std::size_t> members_{0};
+        std::atomic<std::size_t> unborn_{0};
+        std::atomic<std::size_t> alive_{0};
+        std::atomic<std::size_t> dead_{0};
+
+        std::mutex mutex_;
+        std::vector<goblin_waiter> waiters_[3];
+        bool closed_ = false;
+    };
+}
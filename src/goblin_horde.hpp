@@ -0,0 +1,242 @@
+#pragma once
+
+#include "config.hpp"
+#include "goblin.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/** A horde of goblins which costs one byte per goblin while they are dormant.
+ *
+ * Constructing a horde reserves ids and names for its goblins but constructs none of them. Goblin i is kept as a
+ * one-byte record (unborn or dead) until its first event, when it is constructed as a full goblin_impl, exactly
+ * as goblin would have constructed it, and the event is passed on. hibernate() returns awake goblins with nothing
+ * left to lose (see goblin_impl::is_dormant) to their records. Only awake goblins are in the registry and the
+ * goblin world.
+ *
+ * Events which a goblin in the recorded state would answer without changing state are answered from the record:
+ * a dead goblin's death waiters succeed and its birth waiters fail with actually_dead, and a dormant goblin is not
+ * woken for be_born() if dead or for die() if unborn, since neither has a transition to take.
+ *
+ * Like goblins, the goblins of a horde may be used from any thread. The horde owns them: destroying it destroys
+ * every awake goblin as if its goblin handle had been destroyed.
+ */
+class goblin_horde {
+public:
+    using service_type = goblin_service;
+    using implementation_type = goblin_service::implementation_type;
+
+    goblin_horde(asio::io_service &owner, std::size_t count)
+            : service_(std::addressof(asio::use_service<service_type>(owner))),
+              count_(count),
+              records_(new std::atomic<std::uint8_t>[count]) {
+        auto first = service_->reserve(count);
+        first_id_ = first.first;
+        first_name_ = first.second;
+        for (std::size_t i = 0; i < count; ++i) records_[i].store(unborn, std::memory_order_relaxed);
+    }
+
+    goblin_horde(goblin_horde const &) = delete;
+
+    goblin_horde &operator=(goblin_horde const &) = delete;
+
+    auto size() const -> std::size_t { return count_; }
+
+    auto id(std::size_t i) const -> std::uint64_t { return first_id_ + i; }
+
+    /** Does not wake the goblin */
+    auto name(std::size_t i) const -> goblin_name {
+        return goblin_name_generator::name_of(first_name_ + i);
+    }
+
+    /** Does not wake the goblin. A dormant goblin's generation is that of a goblin which has lived as far. */
+    auto snapshot(std::size_t i) const -> goblin_snapshot {
+        std::uint8_t record;
+        auto impl = find(i, record);
+        return impl ? impl->snapshot() : dormant_snapshot(record);
+    }
+
+    bool is_dead(std::size_t i) const { return snapshot(i).is_dead(); }
+
+    auto current_state(std::size_t i) const -> goblin_state_id { return snapshot(i).state; }
+
+    template<class WaitHandler>
+    auto async_spawn(std::size_t i, WaitHandler &&handler) {
+        if (auto impl = wake(i, false)) return service_->async_spawn(impl, std::forward<WaitHandler>(handler));
+        return complete(std::forward<WaitHandler>(handler), goblin_error::actually_dead);
+    }
+
+    template<class WaitHandler>
+    auto on_birth(std::size_t i, WaitHandler &&handler) {
+        if (auto impl = wake(i, false)) return service_->on_birth(impl, std::forward<WaitHandler>(handler));
+        return complete(std::forward<WaitHandler>(handler), goblin_error::actually_dead);
+    }
+
+    template<class WaitHandler>
+    auto wait_death(std::size_t i, WaitHandler &&handler) {
+        if (auto impl = wake(i, false)) return service_->wait_death(impl, std::forward<WaitHandler>(handler));
+        return complete(std::forward<WaitHandler>(handler), asio::error_code());
+    }
+
+    void be_born(std::size_t i) {
+        if (auto impl = wake(i, false)) service_->be_born(impl);
+    }
+
+    void die(std::size_t i) {
+        std::uint8_t record;
+        if (auto impl = find(i, record)) service_->die(impl);
+    }
+
+    /** A reference to goblin i, which is woken if it is dormant. A dead goblin is woken by being born and killed
+     * at once. The reference goes stale if the goblin hibernates, like one to a goblin which is destroyed.
+     */
+    auto ref(std::size_t i) -> goblin_ref {
+        auto impl = wake(i, true);
+        return goblin_ref(*service_, impl->handle());
+    }
+
+    /** Give birth to every goblin which is not dead. See goblin_service::spawn_all. */
+    void spawn_all() {
+        auto impls = collect([this](std::size_t i) { return wake(i, false); });
+        service_->spawn_all(impls.begin(), impls.end());
+    }
+
+    /** Kill every goblin which is awake; the dormant ones are unborn or dead already. See goblin_service::die_all. */
+    void die_all() {
+        auto impls = collect([this](std::size_t i) {
+            std::uint8_t record;
+            return find(i, record);
+        });
+        service_->die_all(impls.begin(), impls.end());
+    }
+
+    /** Return every awake goblin which is dormant, and which nobody else holds, to its record.
+     * @return the number of goblins put to sleep
+     */
+    auto hibernate() -> std::size_t {
+        std::size_t result = 0;
+        for (auto &s : shards_) {
+            // destroyed once the shard is unlocked, since stopping a goblin takes its lock
+            std::vector<implementation_type> released;
+            auto lock = lock_type(s.mutex);
+            for (auto it = s.awake.begin(); it != s.awake.end();) {
+                auto &impl = it->second;
+                // a copy is held by a call in progress
+                if (impl.use_count() != 1 or not impl->is_dormant()) {
+                    ++it;
+                    continue;
+                }
+                auto record = impl->snapshot().dead ? dead : unborn;
+                records_[it->first].store(record, std::memory_order_release);
+                released.push_back(std::move(impl));
+                it = s.awake.erase(it);
+            }
+            awake_.fetch_sub(released.size(), std::memory_order_relaxed);
+            result += released.size();
+            lock.unlock();
+        }
+        return result;
+    }
+
+    /** The number of goblins constructed as goblin_impls */
+    auto awake() const -> std::size_t { return awake_.load(std::memory_order_relaxed); }
+
+private:
+    /* the records */
+    static constexpr std::uint8_t unborn = 0;
+    static constexpr std::uint8_t dead = 1;
+    static constexpr std::uint8_t is_awake = 2;
+
+    static constexpr std::size_t shard_count = 16;
+
+    using lock_type = std::unique_lock<std::mutex>;
+
+    struct shard {
+        std::mutex mutex;
+        std::unordered_map<std::size_t, implementation_type> awake;
+    };
+
+    static auto dormant_snapshot(std::uint8_t record) -> goblin_snapshot {
+        goblin_snapshot result;
+        result.running = true;
+        if (record == dead) {
+            result.state = goblin_state_id::dead;
+            result.dead = true;
+            // started, born and died
+            result.generation = 3;
+        } else {
+            result.generation = 1;
+        }
+        return result;
+    }
+
+    auto shard_of(std::size_t i) const -> shard & {
+        return shards_[i % shard_count];
+    }
+
+    /** The implementation of goblin i if it is awake, otherwise nullptr, with its record */
+    auto find(std::size_t i, std::uint8_t &record) const -> implementation_type {
+        record = records_[i].load(std::memory_order_acquire);
+        if (record != is_awake) return nullptr;
+        auto &s = shard_of(i);
+        auto lock = lock_type(s.mutex);
+        // it may have been put to sleep since
+        record = records_[i].load(std::memory_order_relaxed);
+        if (record != is_awake) return nullptr;
+        return s.awake.find(i)->second;
+    }
+
+    /** The implementation of goblin i, constructed if it is dormant. A dead goblin is left dormant, and nullptr
+     * returned, unless even_if_dead, in which case it is born and killed.
+     */
+    auto wake(std::size_t i, bool even_if_dead) -> implementation_type {
+        auto &s = shard_of(i);
+        auto lock = lock_type(s.mutex);
+        auto record = records_[i].load(std::memory_order_relaxed);
+        if (record == is_awake) return s.awake.find(i)->second;
+        if (record == dead and not even_if_dead) return nullptr;
+
+        auto impl = service_->construct(id(i), name(i));
+        if (record == dead) impl->process_events(GoblinBorn{*impl}, GoblinDies{*impl});
+        s.awake.emplace(i, impl);
+        records_[i].store(is_awake, std::memory_order_release);
+        awake_.fetch_add(1, std::memory_order_relaxed);
+        return impl;
+    }
+
+    template<class F>
+    auto collect(F &&get) -> std::vector<implementation_type> {
+        std::vector<implementation_type> result;
+        for (std::size_t i = 0; i < count_; ++i) {
+            if (auto impl = get(i)) result.push_back(std::move(impl));
+        }
+        return result;
+    }
+
+    /** Complete a handler as a goblin in a dormant state would have */
+    template<class WaitHandler>
+    auto complete(WaitHandler &&handler, asio::error_code const &ec) {
+
+        asio::detail::async_result_init<
+                WaitHandler, void(boost::system::error_code)> init(
+                std::forward<WaitHandler>(handler));
+
+        completion_batch completions;
+        completions.add(service_->make_waiter(std::move(init.handler)), ec);
+        completions.dispatch();
+
+        return init.result.get();
+    }
+
+    service_type *service_;
+    std::size_t count_;
+    std::uint64_t first_id_;
+    std::uint64_t first_name_;
+    std::unique_ptr<std::atomic<std::uint8_t>[]> records_;
+    mutable shard shards_[shard_count];
+    std::atomic<std::size_t> awake_{0};
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "config.hpp"
+#include "goblin.hpp"
+#include "goblin_wire.hpp"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace detail {
+
+    /** The host end of one goblin_link. It owns the goblins the link has constructed, by the link's key for
+     * each, and destroys them all when the link goes away.
+     */
+    struct host_connection : wire_connection<host_connection> {
+        explicit host_connection(asio::io_service &owner)
+                : wire_connection<host_connection>(owner),
+                  service_(asio::use_service<goblin_service>(owner)) {}
+
+        bool handle_frame(wire_frame const &frame, boost::string_view payload, completion_batch &) {
+            switch (frame.op) {
+                case wire_op::construct:
+                    construct(frame.goblin, payload);
+                    return true;
+                case wire_op::destroy:
+                    destroy(frame.goblin);
+                    return true;
+                case wire_op::be_born:
+                    find(frame.goblin).be_born();
+                    return true;
+                case wire_op::die:
+                    find(frame.goblin).die();
+                    return true;
+                case wire_op::spawn:
+                    find(frame.goblin).async_spawn(completer{shared_from_this(), frame.tag});
+                    return true;
+                case wire_op::on_birth:
+                    service_.on_birth(find(frame.goblin).get_implementation(), completer{shared_from_this(), frame.tag});
+                    return true;
+                case wire_op::wait_death:
+                    service_.wait_death(find(frame.goblin).get_implementation(), completer{shared_from_this(), frame.tag});
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        void handle_close(completion_batch &) {
+            auto lock = lock_type(mutex_);
+            auto goblins = std::move(goblins_);
+            goblins_.clear();
+            lock.unlock();
+        }
+
+    private:
+        using lock_type = std::unique_lock<std::mutex>;
+
+        void construct(std::uint64_t key, boost::string_view name) {
+            auto id = service_.reserve(1).first;
+            auto gob = goblin(service_, service_.construct(id, goblin_name(name)));
+
+            // keep the link's copy of the goblin's state up to date. A failure means it was destroyed first.
+            auto weak_self = std::weak_ptr<host_connection>(shared_from_this());
+            auto report = [weak_self, key, ref = gob.ref()](asio::error_code const &ec) {
+                auto self = weak_self.lock();
+                if (ec or not self) return;
+                wire_frame frame;
+                frame.op = wire_op::state;
+                frame.goblin = key;
+                frame.tag = ref.snapshot().pack();
+                self->send(frame);
+            };
+            gob.on_birth(report);
+            gob.wait_death(report);
+
+            auto lock = lock_type(mutex_);
+            goblins_.emplace(key, std::move(gob));
+        }
+
+        void destroy(std::uint64_t key) {
+            auto lock = lock_type(mutex_);
+            auto it = goblins_.find(key);
+            if (it == goblins_.end()) return;
+            auto gob = std::move(it->second);
+            goblins_.erase(it);
+            // the goblin takes its own lock to stop
+            lock.unlock();
+        }
+
+        /** The goblin with a key, or a stale ref, which ignores events and aborts waits, if there is none */
+        auto find(std::uint64_t key) -> goblin_ref {
+            auto lock = lock_type(mutex_);
+            auto it = goblins_.find(key);
+            if (it == goblins_.end()) return goblin_ref(service_, goblin_handle());
+            return it->second.ref();
+        }
+
+        /** Answers a wait from the link */
+        struct completer {
+            std::shared_ptr<host_connection> self;
+            std::uint64_t tag;
+
+            void operator()(asio::error_code const &ec) const {
+                wire_frame frame;
+                frame.op = wire_op::complete;
+                frame.tag = tag;
+                frame.set_error(ec);
+                self->send(frame);
+            }
+        };
+
+        goblin_service &service_;
+        std::mutex mutex_;
+        std::unordered_map<std::uint64_t, goblin> goblins_;
+    };
+}
+
+/** Hosts goblins for goblin_links in other processes, listening on a Unix domain socket.
+ *
+ * Each link's goblins are constructed in this io_service's goblin_service, like any other goblin, and run on
+ * its threads. Waits from a link are answered over the socket when they complete. When a link goes away its
+ * goblins are destroyed, as if their owner had destroyed them.
+ *
+ * The socket file is replaced if it exists, and removed when the host is destroyed. Destroying the host closes
+ * every link.
+ *
+ * A link may construct, kill and wait on goblins, so the host trusts every process which can connect. The socket
+ * file is made accessible to its owner only, and on Linux a connection from a process running as any other user
+ * is closed as soon as it is accepted. Put the socket in a directory which only that user can write to, so that
+ * nobody else can replace it.
+ */
+class goblin_host {
+public:
+    using protocol_type = asio::local::stream_protocol;
+
+    /** Listen at path. Throws boost::system::system_error if it cannot. */
+    goblin_host(asio::io_service &owner, std::string path)
+            : state_(std::make_shared<state>(owner, std::move(path))) {
+        state_->accept();
+    }
+
+    goblin_host(goblin_host const &) = delete;
+
+    goblin_host &operator=(goblin_host const &) = delete;
+
+    ~goblin_host() {
+        state_->close();
+    }
+
+    auto path() const -> std::string const & {
+        return state_->path;
+    }
+
+    /** The number of links connected. The answer may be out of date by the time the caller sees it. */
+    auto connections() const -> std::size_t {
+        auto lock = std::unique_lock<std::mutex>(state_->mutex);
+        std::size_t result = 0;
+        for (auto &connection : state_->connections) result += not connection.expired();
+        return result;
+    }
+
+private:
+    struct state : std::enable_shared_from_this<state> {
+        state(asio::io_service &owner, std::string p)
+                : path(std::move(p)), owner(owner), acceptor(owner), strand(owner) {
+            ::unlink(path.c_str());
+            acceptor.open(protocol_type());
+            acceptor.bind(protocol_type::endpoint(path));
+            if (::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0) {
+                auto ec = asio::error_code(errno, boost::system::system_category());
+                throw boost::system::system_error(ec, "goblin_host: chmod");
+            }
+            acceptor.listen();
+        }
+
+        void accept() {
+            auto connection = std::make_shared<detail::host_connection>(owner);
+            auto self = shared_from_this();
+            acceptor.async_accept(connection->socket(),
+                                  strand.wrap([self, connection](asio::error_code const &ec) {
+                                      if (ec) return;
+                                      if (trusted(connection->socket())) {
+                                          self->add(connection);
+                                          connection->start();
+                                      }
+                                      self->accept();
+                                  }));
+        }
+
+        /** Whether the peer runs as the same user as this process. Only checked on Linux; elsewhere the
+         * permissions of the socket file have to do. A distrusted socket is closed. */
+        template<class Socket>
+        static bool trusted(Socket &socket) {
+#if defined(__linux__)
+            struct ucred credentials{};
+            socklen_t size = sizeof(credentials);
+            if (::getsockopt(socket.native_handle(), SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0
+                or credentials.uid != ::geteuid()) {
+                asio::error_code ignored;
+                socket.close(ignored);
+                return false;
+            }
+#else
+            (void) socket;
+#endif
+            return true;
+        }
+
+        void add(std::shared_ptr<detail::host_connection> const &connection) {
+            auto lock = std::unique_lock<std::mutex>(mutex);
+            connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                             [](auto const &c) { return c.expired(); }),
+                              connections.end());
+            connections.push_back(connection);
+        }
+
+        void close() {
+            auto self = shared_from_this();
+            strand.dispatch([self] {
+                asio::error_code ignored;
+                self->acceptor.close(ignored);
+                ::unlink(self->path.c_str());
+            });
+            auto lock = std::unique_lock<std::mutex>(mutex);
+            for (auto &c : connections) {
+                if (auto connection = c.lock()) connection->close();
+            }
+        }
+
+        std::string const path;
+        asio::io_service &owner;
+        protocol_type::acceptor acceptor;
+        asio::io_service::strand strand;
+        std::mutex mutex;
+        std::vector<std::weak_ptr<detail::host_connection>> connections;
+    };
+
+    std::shared_ptr<state> state_;
+};
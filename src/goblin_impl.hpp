@@ -1,7 +1,29 @@
+#pragma once
+
 #include "config.hpp"
 #include "goblin_state.hpp"
+#include "goblin_mailbox.hpp"
+#include "goblin_name.hpp"
+#include "goblin_group_state.hpp"
+#include "goblin_slot_map.hpp"
+#include "goblin_world.hpp"
+#include <boost/container/small_vector.hpp>
 #include <boost/variant.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
 
+/** How a goblin runs the events sent to it.
+ * locked: the state machine is run on the caller's thread while holding the goblin's mutex.
+ * actor:  events are queued in a lock-free mailbox and the caller returns at once. The mailbox is drained in
+ *         batches by a job on the goblin's executor.
+ */
+enum class goblin_execution_mode {
+    locked,
+    actor,
+};
 
 /* Implementations of goblins are active objects. They are controlled by shared pointers.
  * */
@@ -10,28 +32,76 @@ struct goblin_impl : std::enable_shared_from_this<goblin_impl> {
     GoblinState goblin_state_;
     bool running_ = false;
 
-    goblin_impl(asio::io_service& executor, std::string name) : executor_(executor), name_(name) {}
+    /** The maximum number of events handled by one mailbox job before it yields the executor */
+    static constexpr int mailbox_batch_size = 64;
+
+    goblin_impl(asio::io_service& executor, std::uint64_t id, goblin_name name,
+                goblin_execution_mode mode = goblin_execution_mode::locked,
+                std::shared_ptr<goblin_world> world = nullptr,
+                std::shared_ptr<goblin_kill_hub> kills = nullptr,
+                std::shared_ptr<goblin_slot_map> slots = nullptr)
+            : executor_(executor), id_(id), name_(std::move(name)), mode_(mode),
+              world_(std::move(world)), kills_(std::move(kills)), slots_(std::move(slots)) {
+        goblin_state_.goblin_id = id;
+        goblin_state_.kills = kills_.get();
+        if (world_) world_slot_ = world_->allocate(id);
+        if (slots_) handle_ = slots_->insert(this);
+    }
+
+    goblin_impl(goblin_impl const &) = delete;
+
+    goblin_impl &operator=(goblin_impl const &) = delete;
+
+    ~goblin_impl() {
+        if (slots_) slots_->retire(handle_);
+        if (world_) world_->release(world_slot_);
+    }
 
     void start() {
         auto lock = get_lock();
         goblin_state_.start();
         running_ = true;
+        publish_state();
     }
 
     void stop() {
+        // a stopped goblin can no longer be reached by goblin_refs. Retiring waits for any which are using it.
+        if (slots_) slots_->retire(handle_);
         auto lock = get_lock();
         goblin_state_.stop();
         running_ = false;
+        publish_state();
+        auto completions = goblin_state_.take_completions();
+        lock.unlock();
+        completions.dispatch();
     }
 
-    auto name_copy() const {
-        auto lock = lock_type(mutex_);
+    /** How goblin_refs refer to this goblin. Stale once the goblin is stopped. */
+    auto handle() const -> goblin_handle {
+        return handle_;
+    }
+
+    /** Unique among the goblins of one goblin_service */
+    auto id() const -> std::uint64_t {
+        return id_;
+    }
+
+    // the name never changes after construction, so no lock is needed
+    auto name() const -> goblin_name const & {
         return name_;
     }
 
-    bool is_dead() {
-        auto lock = lock_type(mutex_);
-        return (not running_) or goblin_state_.is_flag_active<PositivelyDead>();
+    /** The state published after the most recent transition. Wait-free; never touches the mutex. */
+    auto snapshot() const -> goblin_snapshot {
+        return goblin_snapshot::unpack(state_word_.load(std::memory_order_acquire));
+    }
+
+    bool is_dead() const {
+        return snapshot().is_dead();
+    }
+
+    auto current_state() const -> goblin_state_id {
+        return snapshot().state;
     }
 
     auto get_weak_ptr() {
@@ -48,27 +118,223 @@ struct goblin_impl : std::enable_shared_from_this<goblin_impl> {
 
     auto get_executor() const -> asio::io_service& { return executor_; }
 
+    /** Record in the goblin world, if there is one, when this goblin will next kill */
+    void set_kill_deadline(goblin_world::clock_type::time_point when) {
+        if (world_) world_->set_deadline(world_slot_, when);
+    }
+
+    auto execution_mode() const -> goblin_execution_mode { return mode_; }
+
+    /** Report this goblin's births and deaths to a group from now on */
+    void join_group(std::shared_ptr<detail::group_state> group) {
+        auto lock = get_lock();
+        auto now = snapshot();
+        group->member_joined(is_settled(now), now.is_dead());
+        groups_.push_back(std::move(group));
+    }
+
+    /** Nothing would be lost if this goblin were replaced by a record of its state: it is dead, or it is unborn
+     * with nobody waiting for it and in no group, and no event is queued for it.
+     */
+    bool is_dormant() const {
+        auto lock = get_lock();
+        auto now = snapshot();
+        if (not now.running or mailbox_scheduled_.load() or mailbox_.maybe_pending()) return false;
+        if (now.dead) return true;
+        return now.state == goblin_state_id::unborn and groups_.empty()
+               and goblin_state_.birth_signals.empty() and goblin_state_.death_signals.empty();
+    }
+
     template<class Message>
     void process_event(Message&& message)
     {
+        completion_batch completions;
+        process_event(std::forward<Message>(message), completions);
+        completions.dispatch();
+    }
+
+    /** Process an event, adding the completions it causes to a batch for the caller to dispatch, so that the
+     * completions of many goblins can be dispatched together. In actor mode the event is queued as usual.
+     */
+    template<class Message>
+    void process_event(Message&& message, completion_batch &completions)
+    {
+        if (mode_ == goblin_execution_mode::actor) {
+            post_events(std::forward<Message>(message));
+            return;
+        }
         auto lock = get_lock();
-        goblin_state_.process_event(message);
+        auto locked_at = goblin_metrics::now();
+        run_event(message);
+        publish_state();
+        completions.append(goblin_state_.take_completions());
+        goblin_metrics::event_processed();
+        goblin_metrics::lock_held(locked_at);
     }
 
+    /** Process a sequence of events as one. No other event will be interleaved with them. */
     template<class...Messages>
     void process_events(Messages&&...msgs)
     {
+        if (mode_ == goblin_execution_mode::actor) {
+            post_events(std::forward<Messages>(msgs)...);
+            return;
+        }
         auto lock = get_lock();
+        auto locked_at = goblin_metrics::now();
         using expand = int[];
         void(expand{
-                (goblin_state_.process_event(msgs), 0)...
+                (run_event(msgs), 0)...
         });
+        publish_state();
+        auto completions = goblin_state_.take_completions();
+        goblin_metrics::event_processed(sizeof...(Messages));
+        goblin_metrics::lock_held(locked_at);
+        lock.unlock();
+        completions.dispatch();
     }
 
+private:
 
+    /** The target of mailbox deliveries, so that they are traced like any other event */
+    struct event_runner {
+        goblin_impl &impl;
+
+        template<class Message>
+        void process_event(Message const &message) {
+            impl.run_event(message);
+        }
+    };
+
+    // Called with the lock held. Records the event and the transition it caused in this thread's trace.
+    template<class Message>
+    void run_event(Message const &message)
+    {
+        auto from = to_state_id(goblin_state_.current_state()[0]);
+        goblin_state_.process_event(message);
+        auto to = to_state_id(goblin_state_.current_state()[0]);
+        goblin_trace::record(id_, trace_event_of<Message>::value, std::uint8_t(from), std::uint8_t(to));
+        note_kill(message);
+    }
+
+    void note_kill(GoblinKilledSomeone const &) {
+        if (not world_) return;
+        world_->add_kill(world_slot_);
+        world_->clear_deadline(world_slot_);
+    }
+
+    template<class Message>
+    void note_kill(Message const &) {}
+
+    template<class...Messages>
+    void post_events(Messages&&...msgs)
+    {
+        using message_type = mailbox_message<event_runner, std::decay_t<Messages>...>;
+        mailbox_.push(message_type::create(std::forward<Messages>(msgs)...));
+        schedule_mailbox();
+    }
+
+    static auto to_state_id(int msm_state) -> goblin_state_id {
+        return goblin_state_::state_id_of<GoblinState>(msm_state);
+    }
+
+    // Called with the lock held after anything which may have changed the state machine. We are the only
+    // writer, so the previous word can be read relaxed.
+    void publish_state() {
+        auto previous = goblin_snapshot::unpack(state_word_.load(std::memory_order_relaxed));
+        goblin_snapshot next;
+        next.state = to_state_id(goblin_state_.current_state()[0]);
+        next.running = running_;
+        next.dead = goblin_state_.is_flag_active<PositivelyDead>();
+        if (next.same_state(previous)) return;
+        next.generation = previous.generation + 1;
+        state_word_.store(next.pack(), std::memory_order_release);
+        if (world_) {
+            world_->set_state(world_slot_, std::uint8_t(next.state), next.running, next.dead);
+            if (next.state != goblin_state_id::killing_folk) world_->clear_deadline(world_slot_);
+        }
+        if (not groups_.empty()) notify_groups(previous, next);
+    }
+
+    /** Born, or stopped without being born and so never will be */
+    static bool is_settled(goblin_snapshot const &s) {
+        return s.state != goblin_state_id::unborn or not s.running;
+    }
+
+    void notify_groups(goblin_snapshot const &previous, goblin_snapshot const &next) {
+        auto born = not is_settled(previous) and is_settled(next);
+        auto died = not previous.is_dead() and next.is_dead();
+        for (auto &group : groups_) {
+            if (born) group->member_born(goblin_state_.completions);
+            if (died) group->member_died(goblin_state_.completions);
+        }
+    }
+
+    // ensure exactly one mailbox job is pending or running
+    void schedule_mailbox()
+    {
+        if (not mailbox_scheduled_.exchange(true)) {
+            executor_.post([self = shared_from_this()] { self->drain_mailbox(); });
+        }
+    }
+
+    void drain_mailbox()
+    {
+        auto lock = get_lock();
+        auto locked_at = goblin_metrics::now();
+        auto runner = event_runner{*this};
+        try {
+            for (int handled = 0; handled < mailbox_batch_size; ++handled) {
+                auto node = mailbox_node_ptr<event_runner>(mailbox_.pop());
+                if (not node) break;
+                node->deliver(runner);
+                publish_state();
+                goblin_metrics::event_processed();
+            }
+        }
+        catch (...) {
+            publish_state();
+            auto completions = goblin_state_.take_completions();
+            lock.unlock();
+            completions.dispatch();
+            end_mailbox_job(true);
+            throw;
+        }
+        auto more = not mailbox_.empty();
+        auto completions = goblin_state_.take_completions();
+        goblin_metrics::lock_held(locked_at);
+        lock.unlock();
+        completions.dispatch();
+        end_mailbox_job(more);
+    }
+
+    void end_mailbox_job(bool more)
+    {
+        // a producer which saw the flag still set is relying on us to pick its message up
+        mailbox_scheduled_.store(false);
+        if (more or mailbox_.maybe_pending()) {
+            schedule_mailbox();
+        }
+    }
+
+public:
 
     asio::io_service& executor_;
     mutable mutex_type mutex_;
-    std::string name_;
+    std::uint64_t const id_;
+    goblin_name const name_;
+
+private:
+    goblin_execution_mode mode_;
+    std::atomic<std::uint64_t> state_word_{goblin_snapshot().pack()};
+    std::atomic<bool> mailbox_scheduled_{false};
+    std::shared_ptr<goblin_world> world_;
+    std::uint32_t world_slot_ = goblin_world::no_slot;
+    std::shared_ptr<goblin_kill_hub> kills_;
+    std::shared_ptr<goblin_slot_map> slots_;
+    goblin_handle handle_;
+    // a goblin is rarely in more than one group
+    boost::container::small_vector<std::shared_ptr<detail::group_state>, 1> groups_;
+    goblin_mailbox<event_runner> mailbox_;
 };
 
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "config.hpp"
+#include "goblin_service.hpp"
+#include "goblin_kills.hpp"
+
+/** A subscription to the kills of every goblin of an io_service's goblin_service.
+ *
+ * Kills made after the stream is constructed are buffered, up to capacity of them, until the subscriber asks for
+ * them. async_next_kills completes with everything buffered, as one batch, so a consumer which falls behind gets
+ * fewer, larger batches rather than one completion per kill. When the buffer is full the overflow policy either
+ * drops new kills or makes the killing goblins wait. A goblin waits after releasing its lock, but still on its
+ * worker thread, so with kill_overflow::block the handler must not run on a thread which a goblin may be blocked
+ * on, for instance a worker thread shared with the goblins, nor under a goblin_simulation, whose one thread runs
+ * everything.
+ */
+class goblin_kill_stream {
+public:
+    using batch_type = detail::kill_subscriber::batch_type;
+
+    static constexpr std::size_t default_capacity = 4096;
+
+    explicit goblin_kill_stream(asio::io_service &owner,
+                                std::size_t capacity = default_capacity,
+                                kill_overflow overflow = kill_overflow::drop)
+            : service_(std::addressof(asio::use_service<goblin_service>(owner))),
+              subscriber_(std::make_shared<detail::kill_subscriber>(capacity, overflow)) {
+        service_->kill_hub().subscribe(subscriber_);
+    }
+
+    goblin_kill_stream(goblin_kill_stream const &) = delete;
+
+    goblin_kill_stream &operator=(goblin_kill_stream const &) = delete;
+
+    ~goblin_kill_stream() {
+        close();
+    }
+
+    /** Wait for the next batch of kills.
+     * The handler has the signature void(asio::error_code, std::vector<goblin_kill>) and is called exactly once,
+     * as if by a call to get_executor().post(). Only one wait may be outstanding; a second fails with
+     * already_started. Once the stream is closed, waits fail with operation_aborted.
+     */
+    template<class Handler>
+    auto async_next_kills(Handler &&handler) {
+
+        asio::detail::async_result_init<
+                Handler, void(boost::system::error_code, batch_type)> init(
+                std::forward<Handler>(handler));
+
+        subscriber_->next(service_->make_async_completion_handler(std::move(init.handler)));
+
+        return init.result.get();
+    }
+
+    /** Stop receiving kills. Kills already buffered are discarded and any outstanding wait is aborted. */
+    void close() {
+        if (closed_) return;
+        closed_ = true;
+        service_->kill_hub().unsubscribe(subscriber_);
+        subscriber_->close();
+    }
+
+    /** The number of kills discarded because the buffer was full */
+    auto dropped() const -> std::uint64_t {
+        return subscriber_->dropped();
+    }
+
+    auto get_executor() const -> asio::io_service & {
+        return service_->get_io_service();
+    }
+
+private:
+    goblin_service *service_;
+    std::shared_ptr<detail::kill_subscriber> subscriber_;
+    bool closed_ = false;
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "config.hpp"
+#include "unique_handler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** One kill, as delivered to a goblin_kill_stream */
+struct goblin_kill {
+    /** the id of the goblin which killed */
+    std::uint64_t goblin;
+    std::chrono::steady_clock::time_point when;
+};
+
+/** What a goblin_kill_stream does with a kill when its buffer is full */
+enum class kill_overflow {
+    /** discard the new kill and count it in dropped() */
+    drop,
+    /** make the thread which reported the kill wait, once it has released the goblin's lock, until the subscriber
+     * takes a batch */
+    block,
+};
+
+namespace detail {
+
+    /** The buffer of one subscriber. Goblins push into it from their worker threads; the subscriber takes
+     * everything buffered at once, so however fast the goblins kill, there is at most one completion posted per
+     * async_next_kills.
+     */
+    class kill_subscriber {
+    public:
+        using batch_type = std::vector<goblin_kill>;
+        using handler_type = unique_handler<void(asio::error_code const &, batch_type)>;
+
+        kill_subscriber(std::size_t capacity, kill_overflow overflow)
+                : capacity_(capacity ? capacity : 1), overflow_(overflow) {
+            buffer_.reserve(capacity_);
+        }
+
+        void push(goblin_kill const &kill) {
+            handler_type handler;
+            batch_type batch;
+            {
+                auto lock = std::unique_lock<std::mutex>(mutex_);
+                if (buffer_.size() >= capacity_) {
+                    if (overflow_ == kill_overflow::drop) {
+                        ++dropped_;
+                        return;
+                    }
+                    space_.wait(lock, [this] { return closed_ or buffer_.size() < capacity_; });
+                }
+                if (closed_) return;
+                buffer_.push_back(kill);
+                if (not waiter_) return;
+                handler = std::move(waiter_);
+                batch = take_batch();
+            }
+            handler(asio::error_code(), std::move(batch));
+        }
+
+        /** Call handler with everything buffered, now if there is anything, otherwise with the next kill */
+        void next(handler_type handler) {
+            batch_type batch;
+            asio::error_code ec;
+            {
+                auto lock = std::unique_lock<std::mutex>(mutex_);
+                if (waiter_) {
+                    ec = asio::error::already_started;
+                } else if (not buffer_.empty()) {
+                    batch = take_batch();
+                } else if (closed_) {
+                    ec = asio::error::operation_aborted;
+                } else {
+                    waiter_ = std::move(handler);
+                    return;
+                }
+            }
+            handler(ec, std::move(batch));
+        }
+
+        /** Fail any waiting handler with operation_aborted and release any blocked goblins */
+        void close() {
+            handler_type handler;
+            {
+                auto lock = std::unique_lock<std::mutex>(mutex_);
+                closed_ = true;
+                buffer_.clear();
+                handler = std::move(waiter_);
+            }
+            space_.notify_all();
+            if (handler) handler(asio::error::operation_aborted, batch_type());
+        }
+
+        auto dropped() const -> std::uint64_t {
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            return dropped_;
+        }
+
+    private:
+        auto take_batch() -> batch_type {
+            batch_type batch;
+            batch.reserve(capacity_);
+            batch.swap(buffer_);
+            space_.notify_all();
+            return batch;
+        }
+
+        std::size_t const capacity_;
+        kill_overflow const overflow_;
+        mutable std::mutex mutex_;
+        std::condition_variable space_;
+        batch_type buffer_;
+        handler_type waiter_;
+        std::uint64_t dropped_ = 0;
+        bool closed_ = false;
+    };
+}
+
+/** Fans the kills of every goblin of a goblin_service out to the subscribed goblin_kill_streams.
+ *
+ * The list of subscribers is replaced, not modified, when a stream subscribes or closes, so publishing reads it
+ * without a lock, and costs one atomic load when nobody is subscribed.
+ */
+class goblin_kill_hub {
+public:
+    using subscriber_ptr = std::shared_ptr<detail::kill_subscriber>;
+
+    bool has_subscribers() const {
+        return bool(std::atomic_load(&subscribers_));
+    }
+
+    void publish(goblin_kill const &kill) {
+        auto subscribers = std::atomic_load(&subscribers_);
+        if (not subscribers) return;
+        for (auto &subscriber : *subscribers) {
+            subscriber->push(kill);
+        }
+    }
+
+    void subscribe(subscriber_ptr subscriber) {
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        auto next = std::make_shared<list_type>(current());
+        next->push_back(std::move(subscriber));
+        std::atomic_store(&subscribers_, std::shared_ptr<list_type const>(std::move(next)));
+    }
+
+    void unsubscribe(subscriber_ptr const &subscriber) {
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        auto next = std::make_shared<list_type>();
+        for (auto &s : current()) {
+            if (s != subscriber) next->push_back(s);
+        }
+        auto replacement = next->empty() ? nullptr : std::shared_ptr<list_type const>(std::move(next));
+        std::atomic_store(&subscribers_, std::move(replacement));
+    }
+
+private:
+    using list_type = std::vector<subscriber_ptr>;
+
+    auto current() const -> list_type {
+        auto subscribers = std::atomic_load(&subscribers_);
+        return subscribers ? *subscribers : list_type();
+    }
+
+    std::mutex mutex_;
+    std::shared_ptr<list_type const> subscribers_;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "config.hpp"
+#include "goblin.hpp"
+#include "goblin_remote_impl.hpp"
+
+#include <memory>
+#include <string>
+
+/** How a goblin_link carries its frames */
+enum class goblin_transport {
+    /** Over the Unix domain socket */
+    socket,
+    /** Through a pair of rings in shared memory, set up over the socket, which then only watches for the host
+     * going away. For a host on the same machine: no syscall per event unless the other side is asleep. */
+    shared_memory,
+};
+
+/** A connection to a goblin_host in another process, over a Unix domain socket.
+ *
+ * Goblins constructed through a link (remote_goblin) live in the host, but are used exactly like local ones:
+ * their goblin_refs are handles in the same service, and async_spawn, wait_death, be_born and the rest work
+ * unchanged. Nothing waits for a reply to go out: the request to construct a goblin and every event after it are
+ * queued on the link in order, and a burst of them is written at once.
+ *
+ * If the host goes away, every wait outstanding on the link completes with goblin_error::host_lost, as does any
+ * wait started afterwards. Destroying the link closes it, with the same effect.
+ */
+class goblin_link {
+public:
+    using protocol_type = asio::local::stream_protocol;
+
+    /** Connect to the host listening at path. Throws boost::system::system_error if it cannot. */
+    goblin_link(asio::io_service &owner, std::string const &path,
+                goblin_transport transport = goblin_transport::socket)
+            : service_(std::addressof(asio::use_service<goblin_service>(owner))),
+              state_(std::make_shared<detail::link_state>(owner, service_->remote_slots())) {
+        state_->socket().connect(protocol_type::endpoint(path));
+        if (transport == goblin_transport::shared_memory) state_->request_shared_memory();
+        state_->start();
+    }
+
+    goblin_link(goblin_link const &) = delete;
+
+    goblin_link &operator=(goblin_link const &) = delete;
+
+    ~goblin_link() {
+        state_->close();
+    }
+
+    /** False once the host has gone away. The answer may be out of date by the time the caller sees it. */
+    bool is_open() const {
+        return state_->is_open();
+    }
+
+    auto get_service() const -> goblin_service & {
+        return *service_;
+    }
+
+    auto get_executor() const -> asio::io_service & {
+        return get_service().get_io_service();
+    }
+
+private:
+    friend struct remote_goblin;
+
+    goblin_service *service_;
+    std::shared_ptr<detail::link_state> state_;
+};
+
+/** A goblin hosted by the process at the other end of a goblin_link.
+ * Like goblin, it owns the goblin: destroying it destroys the goblin in the host, whose waits are then aborted.
+ * Its name is generated here, so it is known at once.
+ */
+struct remote_goblin : goblin_interface<remote_goblin> {
+    using service_type = goblin_service;
+    using implementation_type = goblin_handle;
+
+    explicit remote_goblin(goblin_link &link)
+            : service_(std::addressof(link.get_service())),
+              impl_(std::make_unique<remote_goblin_impl>(link.state_, get_service().remote_slots(),
+                                                         goblin_name_generator()())) {}
+
+    remote_goblin(remote_goblin &&) = default;
+
+    remote_goblin &operator=(remote_goblin &&) = default;
+
+    operator goblin_ref() const {
+        return goblin_ref(get_service(), get_implementation());
+    }
+
+    auto ref() const {
+        return goblin_ref(*this);
+    }
+
+    template<class Handler>
+    auto on_birth(Handler &&handler) {
+        return get_service().on_birth(get_implementation(), std::forward<Handler>(handler));
+    }
+
+    template<class WaitHandler>
+    auto wait_death(WaitHandler &&handler) {
+        return get_service().wait_death(get_implementation(), std::forward<WaitHandler>(handler));
+    }
+
+    /** The goblin's handle, which is stale once this has been moved from */
+    auto get_implementation() const -> implementation_type {
+        return impl_ ? impl_->handle() : goblin_handle();
+    }
+
+    auto get_service() const -> service_type & {
+        return *service_;
+    }
+
+    auto get_executor() const -> asio::io_service & {
+        return get_service().get_io_service();
+    }
+
+private:
+    service_type *service_;
+    std::unique_ptr<remote_goblin_impl> impl_;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "slab_pool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/** A node in a goblin_mailbox. Producers only ever link nodes; the single consumer delivers and destroys them. */
+template<class Target>
+struct mailbox_node {
+    std::atomic<mailbox_node *> next{nullptr};
+
+    virtual void deliver(Target &target) = 0;
+
+    /** Destroy the node and return its storage to the pool */
+    virtual void destroy() noexcept = 0;
+
+protected:
+    ~mailbox_node() = default;
+};
+
+struct mailbox_node_deleter {
+    template<class Node>
+    void operator()(Node *node) const noexcept { node->destroy(); }
+};
+
+template<class Target>
+using mailbox_node_ptr = std::unique_ptr<mailbox_node<Target>, mailbox_node_deleter>;
+
+/** A mailbox_node carrying one or more messages which are delivered together, in order. */
+template<class Target, class...Messages>
+struct mailbox_message final : mailbox_node<Target> {
+
+    template<class...Args>
+    mailbox_message(Args &&...args) : messages_(std::forward<Args>(args)...) {}
+
+    static auto create(Messages...messages) -> mailbox_message * {
+        auto storage = slab_pool::allocate(sizeof(mailbox_message));
+        try {
+            return ::new(storage) mailbox_message(std::move(messages)...);
+        }
+        catch (...) {
+            slab_pool::deallocate(storage, sizeof(mailbox_message));
+            throw;
+        }
+    }
+
+    void deliver(Target &target) override {
+        deliver(target, std::index_sequence_for<Messages...>());
+    }
+
+    void destroy() noexcept override {
+        this->~mailbox_message();
+        slab_pool::deallocate(this, sizeof(mailbox_message));
+    }
+
+private:
+    template<std::size_t...Is>
+    void deliver(Target &target, std::index_sequence<Is...>) {
+        using expand = int[];
+        void(expand{
+                (target.process_event(std::get<Is>(messages_)), 0)...
+        });
+    }
+
+    std::tuple<Messages...> messages_;
+};
+
+/** An intrusive, unbounded, lock-free multi-producer single-consumer queue (after Dmitry Vyukov).
+ *
+ * push() is wait-free and may be called from any thread. pop() and empty() must only be called by the one
+ * consumer currently draining the mailbox. pop() may return nullptr while a producer is part way through a
+ * push; the consumer will see the message on a later pop.
+ */
+template<class Target>
+struct goblin_mailbox {
+    using node_type = mailbox_node<Target>;
+
+    goblin_mailbox() = default;
+
+    goblin_mailbox(goblin_mailbox const &) = delete;
+
+    goblin_mailbox &operator=(goblin_mailbox const &) = delete;
+
+    ~goblin_mailbox() {
+        while (auto node = pop()) {
+            node->destroy();
+        }
+    }
+
+    void push(node_type *node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        auto prev = head_.exchange(node);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    auto pop() -> node_type * {
+        auto tail = tail_;
+        auto next = tail->next.load(std::memory_order_acquire);
+        if (tail == stub()) {
+            if (not next) return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load()) {
+            // a producer has claimed the head but not yet linked its node
+            return nullptr;
+        }
+        push(stub());
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    /** True if nothing has been pushed which has not been popped, including pushes still in progress.
+     * Consumer only. */
+    bool empty() const {
+        return tail_ == stub() and head_.load() == stub();
+    }
+
+    /** False only if the queue was drained empty when last observed. Unlike empty() this may be called from
+     * any thread, so a consumer can check for late arrivals after giving up the consumer role. */
+    bool maybe_pending() const {
+        return head_.load() != stub();
+    }
+
+private:
+    struct stub_node final : node_type {
+        void deliver(Target &) override {}
+
+        void destroy() noexcept override {}
+    };
+
+    auto stub() const -> node_type * { return const_cast<stub_node *>(&stub_); }
+
+    stub_node stub_;
+    std::atomic<node_type *> head_{stub()};
+    node_type *tail_ = stub();
+};
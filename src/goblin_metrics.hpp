@@ -0,0 +1,308 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** A log-linear histogram of non-negative values, in the manner of HdrHistogram.
+ *
+ * Values are bucketed by their power of two, and each power of two is split into sub_buckets linear buckets, so
+ * every value is held to within 1/sub_buckets of itself. Values below sub_buckets are held exactly.
+ */
+struct metrics_histogram {
+    static constexpr std::size_t sub_bucket_bits = 3;
+    static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bucket_bits;
+    static constexpr std::size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    static auto index_of(std::uint64_t value) -> std::size_t {
+        if (value < sub_buckets) return std::size_t(value);
+        auto magnitude = std::size_t(63 - __builtin_clzll(value));
+        auto shift = magnitude - sub_bucket_bits;
+        return (shift + 1) * sub_buckets + std::size_t((value >> shift) & (sub_buckets - 1));
+    }
+
+    /** The smallest value held by a bucket */
+    static auto lowest_in(std::size_t index) -> std::uint64_t {
+        if (index < sub_buckets) return index;
+        auto shift = index / sub_buckets - 1;
+        return std::uint64_t(sub_buckets + index % sub_buckets) << shift;
+    }
+
+    /** The largest value held by a bucket */
+    static auto highest_in(std::size_t index) -> std::uint64_t {
+        return index + 1 < bucket_count ? lowest_in(index + 1) - 1 : ~std::uint64_t(0);
+    }
+
+    void record(std::uint64_t value, std::uint64_t times = 1) {
+        counts_[index_of(value)] += times;
+        total_ += times;
+        sum_ += value * times;
+    }
+
+    void add_bucket(std::size_t index, std::uint64_t count) {
+        if (count == 0) return;
+        counts_[index] += count;
+        total_ += count;
+        // the exact values are not kept, so the sum assumes the middle of the bucket
+        sum_ += count * (lowest_in(index) + (highest_in(index) - lowest_in(index)) / 2);
+    }
+
+    void merge(metrics_histogram const &other) {
+        for (std::size_t i = 0; i < bucket_count; ++i) counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        sum_ += other.sum_;
+    }
+
+    auto count() const -> std::uint64_t { return total_; }
+
+    auto mean() const -> double { return total_ ? double(sum_) / double(total_) : 0.0; }
+
+    /** The highest value equivalent to the value at the given quantile (0.0 - 1.0) */
+    auto percentile(double q) const -> std::uint64_t {
+        if (total_ == 0) return 0;
+        auto rank = std::uint64_t(q * double(total_ - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return highest_in(i);
+        }
+        return highest_in(bucket_count - 1);
+    }
+
+    auto max() const -> std::uint64_t {
+        for (std::size_t i = bucket_count; i-- > 0;) {
+            if (counts_[i]) return highest_in(i);
+        }
+        return 0;
+    }
+
+private:
+    std::array<std::uint64_t, bucket_count> counts_{};
+    std::uint64_t total_ = 0;
+    std::uint64_t sum_ = 0;
+};
+
+/** Everything the goblins have recorded, summed over every thread. Times are in nanoseconds. */
+struct goblin_metrics_report {
+    /** indexed by goblin_state_id */
+    static constexpr std::size_t state_count = 3;
+
+    std::uint64_t events_processed = 0;
+    std::uint64_t waiters_fired = 0;
+    std::array<std::uint64_t, state_count> state_entries{};
+
+    /** how long goblins stayed in each state, recorded when they leave it */
+    std::array<metrics_histogram, state_count> state_residency;
+
+    /** how long each process_event, process_events or mailbox batch held the goblin's mutex */
+    metrics_histogram lock_hold;
+
+    /** how many waiters each fire_wait_handlers call completed */
+    metrics_histogram fan_out;
+
+    void print(std::ostream &os) const {
+        static char const *const state_names[state_count] = {"Unborn", "KillingFolk", "Dead"};
+        os << "events processed: " << events_processed << ", waiters fired: " << waiters_fired << '\n';
+        for (std::size_t s = 0; s < state_count; ++s) {
+            print_line(os, std::string(state_names[s]) + " residency (ns)", state_residency[s]);
+            os << "    entered " << state_entries[s] << " times\n";
+        }
+        print_line(os, "lock hold (ns)", lock_hold);
+        print_line(os, "fan out", fan_out);
+    }
+
+private:
+    static void print_line(std::ostream &os, std::string const &name, metrics_histogram const &h) {
+        os << name << ": count " << h.count() << " mean " << std::uint64_t(h.mean() + 0.5)
+           << " p50 " << h.percentile(0.5) << " p99 " << h.percentile(0.99)
+           << " p99.9 " << h.percentile(0.999) << " max " << h.max() << '\n';
+    }
+};
+
+#if defined(GOBLINS_ENABLE_METRICS)
+
+namespace detail {
+
+    /** The metrics recorded by one thread. Only that thread writes; collect() reads concurrently, so the cells
+     * are atomic, but they are updated with relaxed loads and stores rather than read-modify-write.
+     */
+    struct thread_metrics {
+        using cell = std::atomic<std::uint64_t>;
+
+        struct histogram_cells {
+            std::array<cell, metrics_histogram::bucket_count> counts{};
+
+            void record(std::uint64_t value) { bump(counts[metrics_histogram::index_of(value)]); }
+
+            void add_to(metrics_histogram &h) const {
+                for (std::size_t i = 0; i < counts.size(); ++i) {
+                    h.add_bucket(i, counts[i].load(std::memory_order_relaxed));
+                }
+            }
+        };
+
+        static void bump(cell &c, std::uint64_t n = 1) {
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        cell events_processed{0};
+        cell waiters_fired{0};
+        std::array<cell, goblin_metrics_report::state_count> state_entries{};
+        std::array<histogram_cells, goblin_metrics_report::state_count> state_residency;
+        histogram_cells lock_hold;
+        histogram_cells fan_out;
+        std::atomic<bool> in_use{false};
+    };
+
+    /** Every thread_metrics ever created. A thread claims one the first time it records anything and gives it
+     * back when it exits; blocks are never freed, so their counts survive for the next claimant and collect().
+     */
+    struct metrics_registry {
+        static auto instance() -> metrics_registry & {
+            // leaked, so that threads may record during static destruction
+            static metrics_registry *registry = new metrics_registry();
+            return *registry;
+        }
+
+        auto claim() -> thread_metrics * {
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            for (auto &block : blocks_) {
+                if (not block->in_use.exchange(true)) return block.get();
+            }
+            blocks_.push_back(std::make_unique<thread_metrics>());
+            blocks_.back()->in_use.store(true);
+            return blocks_.back().get();
+        }
+
+        void give_back(thread_metrics *block) {
+            block->in_use.store(false);
+        }
+
+        auto collect() -> goblin_metrics_report {
+            goblin_metrics_report report;
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            for (auto &block : blocks_) {
+                report.events_processed += block->events_processed.load(std::memory_order_relaxed);
+                report.waiters_fired += block->waiters_fired.load(std::memory_order_relaxed);
+                for (std::size_t s = 0; s < goblin_metrics_report::state_count; ++s) {
+                    report.state_entries[s] += block->state_entries[s].load(std::memory_order_relaxed);
+                    block->state_residency[s].add_to(report.state_residency[s]);
+                }
+                block->lock_hold.add_to(report.lock_hold);
+                block->fan_out.add_to(report.fan_out);
+            }
+            return report;
+        }
+
+    private:
+        metrics_registry() = default;
+
+        std::mutex mutex_;
+        std::vector<std::unique_ptr<thread_metrics>> blocks_;
+    };
+
+    inline auto this_thread_metrics() -> thread_metrics & {
+        struct owner {
+            owner() : block(metrics_registry::instance().claim()) {}
+
+            ~owner() { metrics_registry::instance().give_back(block); }
+
+            thread_metrics *block;
+        };
+        static thread_local owner mine;
+        return *mine.block;
+    }
+}
+
+#endif
+
+/** The instrumentation points of the goblins.
+ *
+ * With GOBLINS_ENABLE_METRICS defined, each thread records into its own counters and histograms, and collect()
+ * sums them. Otherwise every function is empty, stamp carries nothing and collect() returns an empty report.
+ */
+struct goblin_metrics {
+#if defined(GOBLINS_ENABLE_METRICS)
+    static constexpr bool enabled = true;
+
+    using stamp = std::chrono::steady_clock::time_point;
+
+    static auto now() -> stamp { return std::chrono::steady_clock::now(); }
+
+    static void event_processed(std::size_t n = 1) {
+        detail::thread_metrics::bump(detail::this_thread_metrics().events_processed, n);
+    }
+
+    static void lock_held(stamp since) {
+        detail::this_thread_metrics().lock_hold.record(nanoseconds_since(since));
+    }
+
+    static void waiters_fired(std::size_t n) {
+        auto &mine = detail::this_thread_metrics();
+        detail::thread_metrics::bump(mine.waiters_fired, n);
+        mine.fan_out.record(n);
+    }
+
+    static void state_entered(std::size_t state) {
+        detail::thread_metrics::bump(detail::this_thread_metrics().state_entries[state]);
+    }
+
+    static void state_left(std::size_t state, stamp entered) {
+        detail::this_thread_metrics().state_residency[state].record(nanoseconds_since(entered));
+    }
+
+    static auto collect() -> goblin_metrics_report {
+        return detail::metrics_registry::instance().collect();
+    }
+
+private:
+    static auto nanoseconds_since(stamp since) -> std::uint64_t {
+        auto elapsed = std::chrono::steady_clock::now() - since;
+        return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+#else
+    static constexpr bool enabled = false;
+
+    struct stamp {};
+
+    static auto now() -> stamp { return {}; }
+
+    static void event_processed(std::size_t = 1) {}
+
+    static void lock_held(stamp) {}
+
+    static void waiters_fired(std::size_t) {}
+
+    static void state_entered(std::size_t) {}
+
+    static void state_left(std::size_t, stamp) {}
+
+    static auto collect() -> goblin_metrics_report { return {}; }
+#endif
+};
+
+/** When a state machine entered its current state, for goblin_metrics::state_left.
+ * Empty unless metrics are enabled, so a class which derives from it pays nothing for it.
+ */
+struct goblin_state_timer {
+#if defined(GOBLINS_ENABLE_METRICS)
+    void mark_entered() { entered_at_ = goblin_metrics::now(); }
+
+    auto entered_at() const -> goblin_metrics::stamp { return entered_at_; }
+
+private:
+    goblin_metrics::stamp entered_at_;
+#else
+    void mark_entered() {}
+
+    auto entered_at() const -> goblin_metrics::stamp { return {}; }
+#endif
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "slab_pool.hpp"
+
+#include <boost/utility/string_view.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace detail {
+
+    /** The immutable text of a name, shared by every goblin_name with that text.
+     * Allocated from the slab_pool with the characters stored immediately after the header.
+     */
+    struct name_entry {
+        std::atomic<std::uint32_t> references;
+        std::uint32_t hash;
+        std::uint32_t length;
+        name_entry *next;
+
+        auto text() const -> char const * { return reinterpret_cast<char const *>(this + 1); }
+
+        auto text() -> char * { return reinterpret_cast<char *>(this + 1); }
+
+        static auto storage_size(std::size_t length) -> std::size_t {
+            return sizeof(name_entry) + length + 1;
+        }
+    };
+
+    /** The process-wide table of interned names.
+     *
+     * Names are spread over shards by hash; each shard is a chained hash table of name_entry under its own
+     * mutex. Only interning a name and releasing the last reference to one touch a shard. Copying, comparing
+     * and reading names never do.
+     *
+     * An entry whose count has reached zero is never revived: a concurrent intern of the same text creates a
+     * new entry, and the old one is unlinked by whoever released it.
+     */
+    struct name_table {
+        static constexpr std::size_t shard_count = 16;
+
+        static auto instance() -> name_table & {
+            // leaked, so that names may outlive static destruction
+            static name_table *table = new name_table();
+            return *table;
+        }
+
+        auto intern(char const *text, std::size_t length) -> name_entry * {
+            auto hash = hash_of(text, length);
+            auto &shard = shards_[hash % shard_count];
+            auto lock = std::unique_lock<std::mutex>(shard.mutex);
+
+            if (not shard.buckets.empty()) {
+                for (auto entry = shard.buckets[bucket_of(shard, hash)]; entry; entry = entry->next) {
+                    if (entry->hash == hash and entry->length == length
+                        and std::memcmp(entry->text(), text, length) == 0
+                        and acquire_if_live(*entry)) {
+                        return entry;
+                    }
+                }
+            }
+
+            auto entry = static_cast<name_entry *>(slab_pool::allocate(name_entry::storage_size(length)));
+            ::new(entry) name_entry{{1}, hash, std::uint32_t(length), nullptr};
+            std::memcpy(entry->text(), text, length);
+            entry->text()[length] = 0;
+
+            if (shard.size + 1 > shard.buckets.size()) {
+                rehash(shard);
+            }
+            auto &head = shard.buckets[bucket_of(shard, hash)];
+            entry->next = head;
+            head = entry;
+            ++shard.size;
+            return entry;
+        }
+
+        void release(name_entry *entry) noexcept {
+            if (entry->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+            auto &shard = shards_[entry->hash % shard_count];
+            {
+                auto lock = std::unique_lock<std::mutex>(shard.mutex);
+                for (auto link = &shard.buckets[bucket_of(shard, entry->hash)]; *link; link = &(*link)->next) {
+                    if (*link == entry) {
+                        *link = entry->next;
+                        --shard.size;
+                        break;
+                    }
+                }
+            }
+            auto length = entry->length;
+            entry->~name_entry();
+            slab_pool::deallocate(entry, name_entry::storage_size(length));
+        }
+
+        auto size() const -> std::size_t {
+            std::size_t result = 0;
+            for (auto &shard : shards_) {
+                auto lock = std::unique_lock<std::mutex>(shard.mutex);
+                result += shard.size;
+            }
+            return result;
+        }
+
+    private:
+        struct alignas(64) shard_type {
+            mutable std::mutex mutex;
+            std::vector<name_entry *> buckets;
+            std::size_t size = 0;
+        };
+
+        name_table() = default;
+
+        // FNV-1a
+        static auto hash_of(char const *text, std::size_t length) -> std::uint32_t {
+            std::uint32_t hash = 2166136261u;
+            for (std::size_t i = 0; i < length; ++i) {
+                hash ^= static_cast<unsigned char>(text[i]);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        static auto bucket_of(shard_type const &shard, std::uint32_t hash) -> std::size_t {
+            // the low bits choose the shard
+            return (hash / shard_count) & (shard.buckets.size() - 1);
+        }
+
+        static bool acquire_if_live(name_entry &entry) {
+            auto count = entry.references.load(std::memory_order_relaxed);
+            while (count != 0) {
+                if (entry.references.compare_exchange_weak(count, count + 1, std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void rehash(shard_type &shard) {
+            auto old = std::move(shard.buckets);
+            shard.buckets.assign(old.empty() ? 64 : old.size() * 2, nullptr);
+            for (auto head : old) {
+                while (head) {
+                    auto next = head->next;
+                    auto &bucket = shard.buckets[bucket_of(shard, head->hash)];
+                    head->next = bucket;
+                    bucket = head;
+                    head = next;
+                }
+            }
+        }
+
+        shard_type shards_[shard_count];
+    };
+}
+
+/** An immutable, interned goblin name.
+ *
+ * A goblin_name is a counted reference to text held in the process-wide name table, so it is as cheap to copy as
+ * a shared_ptr and never allocates once created. Names with the same text share storage. The text is
+ * null-terminated and never changes.
+ */
+class goblin_name {
+public:
+    goblin_name() noexcept = default;
+
+    /** Intern the text, or share the existing entry if the table already holds it */
+    explicit goblin_name(boost::string_view text)
+            : entry_(detail::name_table::instance().intern(text.data(), text.size())) {}
+
+    goblin_name(goblin_name const &other) noexcept : entry_(other.entry_) {
+        if (entry_) entry_->references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    goblin_name(goblin_name &&other) noexcept : entry_(std::exchange(other.entry_, nullptr)) {}
+
+    goblin_name &operator=(goblin_name other) noexcept {
+        std::swap(entry_, other.entry_);
+        return *this;
+    }
+
+    ~goblin_name() {
+        if (entry_) detail::name_table::instance().release(entry_);
+    }
+
+    auto view() const noexcept -> boost::string_view {
+        return entry_ ? boost::string_view(entry_->text(), entry_->length) : boost::string_view();
+    }
+
+    auto c_str() const noexcept -> char const * { return entry_ ? entry_->text() : ""; }
+
+    auto size() const noexcept -> std::size_t { return entry_ ? entry_->length : 0; }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    auto str() const -> std::string { return std::string(c_str(), size()); }
+
+    operator boost::string_view() const noexcept { return view(); }
+
+    friend bool operator==(goblin_name const &l, goblin_name const &r) noexcept {
+        // interned names with equal text normally share an entry
+        return l.entry_ == r.entry_ or l.view() == r.view();
+    }
+
+    friend bool operator!=(goblin_name const &l, goblin_name const &r) noexcept { return not(l == r); }
+
+    friend bool operator<(goblin_name const &l, goblin_name const &r) noexcept { return l.view() < r.view(); }
+
+    friend auto operator<<(std::ostream &os, goblin_name const &name) -> std::ostream & {
+        return os.write(name.c_str(), name.size());
+    }
+
+private:
+    detail::name_entry *entry_ = nullptr;
+};
@@ -4,33 +4,75 @@
 
 #pragma once
 
+#include "goblin_name.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+/** Generates the names "yarr!", "gnurgghhh!", "fgumschak!", "yarr! 1", "gnurgghhh! 1"... in sequence.
+ * The sequence is shared by every generator and is safe to advance from any number of threads.
+ * Names are composed in a local buffer and interned, so generating one does not allocate unless its text is
+ * new to the name table.
+ */
 class goblin_name_generator {
-    struct impl {
-        auto generate() {
-            auto result = names[pos];
-            if (iteration) {
-                result += " " + std::to_string(iteration);
-            }
-            if (++pos >= names.size()) {
-                iteration++;
-                pos = 0;
-            }
-            return result;
-        }
+    static auto names() -> std::array<char const *, 3> const & {
+        static const std::array<char const *, 3> names = {{"yarr!", "gnurgghhh!", "fgumschak!"}};
+        return names;
+    }
 
-        int iteration = 0;
-        int pos = 0;
-        std::array<std::string, 3> names = {"yarr!", "gnurgghhh!", "fgumschak!"};
-    };
+    static auto sequence() -> std::atomic<std::uint64_t> & {
+        static std::atomic<std::uint64_t> next{0};
+        return next;
+    }
 
-    static impl &get_impl() {
-        static impl _{};
-        return _;
+    static auto format(char *buffer, std::uint64_t n) -> std::size_t {
+        char digits[20];
+        std::size_t count = 0;
+        do {
+            digits[count++] = char('0' + n % 10);
+            n /= 10;
+        } while (n);
+        for (std::size_t i = 0; i < count; ++i) {
+            buffer[i] = digits[count - 1 - i];
+        }
+        return count;
     }
 
 public:
-    std::string operator()() const {
-        return get_impl().generate();
+    /** The name at position n of the sequence */
+    static auto name_of(std::uint64_t n) -> goblin_name {
+        auto base = names()[n % names().size()];
+        auto iteration = n / names().size();
+
+        char buffer[64];
+        auto length = std::strlen(base);
+        std::memcpy(buffer, base, length);
+        if (iteration) {
+            buffer[length++] = ' ';
+            length += format(buffer + length, iteration);
+        }
+        return goblin_name(boost::string_view(buffer, length));
+    }
+
+    goblin_name operator()() const {
+        return name_of(sequence().fetch_add(1, std::memory_order_relaxed));
+    }
+
+    /** Reserve the next count names without generating them.
+     * @return the position of the first, so that name i of them is name_of(first + i)
+     */
+    auto reserve(std::size_t count) const -> std::uint64_t {
+        return sequence().fetch_add(count, std::memory_order_relaxed);
     }
-};
 
+    /** Call f(goblin_name) with the next count names. The sequence is advanced once, by count. */
+    template<class F>
+    void generate_n(std::size_t count, F &&f) const {
+        auto first = reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            f(name_of(first + i));
+        }
+    }
+};
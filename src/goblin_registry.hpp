@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** A registry of weak references to every goblin implementation created by a goblin_service.
+ *
+ * The registry is split into shards, each with its own mutex and slot map, so that threads constructing
+ * goblins concurrently do not contend. A thread always inserts into the same shard.
+ *
+ * Entries are never removed explicitly. Instead, every insertion examines a couple of slots at the shard's
+ * sweep cursor and recycles any whose goblin has expired. Under steady spawn/die load the cursor sweeps the
+ * whole shard in a bounded number of insertions, so the registry stays roughly the size of the live population.
+ */
+template<class Implementation>
+struct goblin_registry {
+    using value_type = std::weak_ptr<Implementation>;
+
+    /** The number of slots examined for expiry on each insertion */
+    static constexpr std::size_t sweep_per_insert = 2;
+
+    explicit goblin_registry(std::size_t shard_count = default_shard_count())
+            : shard_count_(shard_count ? shard_count : 1), shards_(new shard[shard_count_]) {}
+
+    static auto default_shard_count() -> std::size_t {
+        auto n = std::size_t(std::thread::hardware_concurrency());
+        return n ? n * 2 : 8;
+    }
+
+    void insert(value_type entry) {
+        auto &s = local_shard();
+        auto lock = lock_type(s.mutex);
+        s.sweep(sweep_per_insert);
+        s.insert(std::move(entry));
+    }
+
+    /** Insert count entries made by make(), taking the shard's mutex once. make() is called with the mutex held,
+     * so it must not use this registry. The sweep covers as many slots as count single insertions would.
+     */
+    template<class Make>
+    void insert_n(std::size_t count, Make &&make) {
+        auto &s = local_shard();
+        auto lock = lock_type(s.mutex);
+        for (std::size_t i = 0; i < count; ++i) {
+            s.sweep(sweep_per_insert);
+            s.insert(value_type(make()));
+        }
+    }
+
+    /** Call f(std::shared_ptr<Implementation>) for each goblin which is still alive.
+     * Expired entries encountered on the way are recycled. Each shard is locked in turn while it is visited,
+     * so f must not construct goblins on this registry.
+     */
+    template<class F>
+    void for_each(F &&f) {
+        for (std::size_t i = 0; i < shard_count_; ++i) {
+            auto &s = shards_[i];
+            auto lock = lock_type(s.mutex);
+            for (std::size_t index = 0; index < s.slots.size(); ++index) {
+                auto &slot = s.slots[index];
+                if (not slot.occupied) continue;
+                if (auto p = slot.entry.lock()) {
+                    f(std::move(p));
+                } else {
+                    s.release(index);
+                }
+            }
+        }
+    }
+
+    /** The number of occupied slots, including entries which have expired but not yet been swept */
+    auto size() const -> std::size_t {
+        std::size_t result = 0;
+        for (std::size_t i = 0; i < shard_count_; ++i) {
+            auto lock = lock_type(shards_[i].mutex);
+            result += shards_[i].occupied;
+        }
+        return result;
+    }
+
+    /** The number of slots allocated across all shards */
+    auto capacity() const -> std::size_t {
+        std::size_t result = 0;
+        for (std::size_t i = 0; i < shard_count_; ++i) {
+            auto lock = lock_type(shards_[i].mutex);
+            result += shards_[i].slots.size();
+        }
+        return result;
+    }
+
+    auto shard_count() const -> std::size_t { return shard_count_; }
+
+private:
+    using mutex_type = std::mutex;
+    using lock_type = std::unique_lock<mutex_type>;
+
+    static constexpr std::uint32_t no_slot = ~std::uint32_t(0);
+
+    struct slot {
+        value_type entry;
+        std::uint32_t next_free = no_slot;
+        bool occupied = false;
+    };
+
+    // a shard's mutex is hammered by its own threads; alignment keeps each shard on cache lines of its own
+    struct alignas(64) shard {
+        void insert(value_type entry) {
+            std::uint32_t index;
+            if (free_head != no_slot) {
+                index = free_head;
+                free_head = slots[index].next_free;
+            } else {
+                index = static_cast<std::uint32_t>(slots.size());
+                slots.emplace_back();
+            }
+            auto &s = slots[index];
+            s.entry = std::move(entry);
+            s.occupied = true;
+            ++occupied;
+        }
+
+        void release(std::size_t index) {
+            auto &s = slots[index];
+            s.entry.reset();
+            s.occupied = false;
+            s.next_free = free_head;
+            free_head = static_cast<std::uint32_t>(index);
+            --occupied;
+        }
+
+        void sweep(std::size_t count) {
+            if (slots.empty()) return;
+            while (count--) {
+                if (sweep_cursor >= slots.size()) sweep_cursor = 0;
+                auto &s = slots[sweep_cursor];
+                if (s.occupied and s.entry.expired()) {
+                    release(sweep_cursor);
+                }
+                ++sweep_cursor;
+            }
+        }
+
+        mutable mutex_type mutex;
+        std::vector<slot> slots;
+        std::uint32_t free_head = no_slot;
+        std::size_t sweep_cursor = 0;
+        std::size_t occupied = 0;
+    };
+
+    auto local_shard() -> shard & {
+        static std::atomic<std::size_t> next_thread_index{0};
+        static thread_local std::size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+        return shards_[thread_index % shard_count_];
+    }
+
+    std::size_t shard_count_;
+    std::unique_ptr<shard[]> shards_;
+};
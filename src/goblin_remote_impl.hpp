@@ -0,0 +1,226 @@
+#pragma once
+
+#include "config.hpp"
+#include "completion_batch.hpp"
+#include "goblin_group_state.hpp"
+#include "goblin_name.hpp"
+#include "goblin_slot_map.hpp"
+#include "goblin_state.hpp"
+#include "goblin_wire.hpp"
+
+#include <boost/container/small_vector.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+struct remote_goblin_impl;
+
+using remote_slot_map = basic_slot_map<remote_goblin_impl>;
+
+namespace detail {
+
+    /** The client end of a goblin_link.
+     * Frames name a goblin by the value of its handle in the service's remote_slot_map, so answers are routed
+     * back by looking the handle up again: a goblin destroyed in the meantime simply misses its news.
+     * Waiters are kept here, by tag, until the host answers or the link goes down. When it goes down, the host
+     * has destroyed the link's goblins, so they are stopped here too.
+     */
+    struct link_state : wire_connection<link_state> {
+        link_state(asio::io_service &owner, std::shared_ptr<remote_slot_map> slots)
+                : wire_connection<link_state>(owner), slots_(std::move(slots)) {}
+
+        /** Keep track of a goblin constructed through the link. False if the link is down already. */
+        bool attach(goblin_handle goblin) {
+            auto lock = lock_type(mutex_);
+            if (lost_) return false;
+            goblins_.insert(goblin.value);
+            return true;
+        }
+
+        void detach(goblin_handle goblin) {
+            auto lock = lock_type(mutex_);
+            goblins_.erase(goblin.value);
+        }
+
+        /** Send a wait and keep the waiter until it is answered. If the link is down it fails at once. */
+        void wait(wire_op op, goblin_handle goblin, goblin_waiter waiter) {
+            auto lock = lock_type(mutex_);
+            if (lost_) {
+                lock.unlock();
+                completion_batch completions;
+                completions.add(std::move(waiter), goblin_error::host_lost);
+                completions.dispatch();
+                return;
+            }
+            auto tag = next_tag_++;
+            waiters_.emplace(tag, std::move(waiter));
+            lock.unlock();
+
+            wire_frame frame;
+            frame.op = op;
+            frame.goblin = goblin.value;
+            frame.tag = tag;
+            send(frame);
+        }
+
+        bool handle_frame(wire_frame const &frame, boost::string_view payload, completion_batch &completions);
+
+        void handle_close(completion_batch &completions);
+
+    private:
+        using lock_type = std::unique_lock<std::mutex>;
+
+        std::shared_ptr<remote_slot_map> slots_;
+        std::mutex mutex_;
+        bool lost_ = false;
+        std::uint64_t next_tag_ = 0;
+        std::unordered_map<std::uint64_t, goblin_waiter> waiters_;
+        std::unordered_set<std::uint64_t> goblins_;
+    };
+}
+
+/** The local face of a goblin hosted by another process, reached through a goblin_link.
+ *
+ * Events and waits are sent to the host as frames. The goblin's name is chosen here and sent with the request to
+ * construct it, so it is known at once, and its state is a copy which the host keeps up to date by sending a
+ * snapshot whenever the goblin is born or dies; like any snapshot it may be out of date by the time it is read.
+ * Groups which the goblin joins are told of its birth and death when the copy changes.
+ */
+struct remote_goblin_impl {
+    remote_goblin_impl(std::shared_ptr<detail::link_state> link, std::shared_ptr<remote_slot_map> slots,
+                       goblin_name name)
+            : link_(std::move(link)), slots_(std::move(slots)), name_(std::move(name)) {
+        goblin_snapshot initial;
+        initial.running = true;
+        initial.generation = 1;
+        state_word_.store(initial.pack(), std::memory_order_relaxed);
+        handle_ = slots_->insert(this);
+        if (link_->attach(handle_)) {
+            send(detail::wire_op::construct, name_.view());
+        } else {
+            initial.running = false;
+            state_word_.store(initial.pack(), std::memory_order_relaxed);
+        }
+    }
+
+    remote_goblin_impl(remote_goblin_impl const &) = delete;
+
+    remote_goblin_impl &operator=(remote_goblin_impl const &) = delete;
+
+    /** Stop using the goblin, and ask the host to destroy it. Its outstanding waits are aborted by the host. */
+    ~remote_goblin_impl() {
+        slots_->retire(handle_);
+        link_->detach(handle_);
+        completion_batch completions;
+        stop(completions);
+        completions.dispatch();
+        send(detail::wire_op::destroy);
+    }
+
+    auto handle() const -> goblin_handle { return handle_; }
+
+    auto name() const -> goblin_name { return name_; }
+
+    auto snapshot() const -> goblin_snapshot {
+        return goblin_snapshot::unpack(state_word_.load(std::memory_order_acquire));
+    }
+
+    void send(detail::wire_op op, boost::string_view payload = {}) {
+        detail::wire_frame frame;
+        frame.op = op;
+        frame.goblin = handle_.value;
+        link_->send(frame, payload);
+    }
+
+    void wait(detail::wire_op op, goblin_waiter waiter) {
+        link_->wait(op, handle_, std::move(waiter));
+    }
+
+    void join_group(std::shared_ptr<detail::group_state> group) {
+        auto lock = lock_type(mutex_);
+        auto now = snapshot();
+        group->member_joined(is_settled(now), now.is_dead());
+        groups_.push_back(std::move(group));
+    }
+
+    /** Take the host's news of the goblin's state, which it sends as a packed goblin_snapshot */
+    void update(std::uint64_t word, completion_batch &completions) {
+        auto lock = lock_type(mutex_);
+        auto previous = snapshot();
+        auto next = goblin_snapshot::unpack(word);
+        // a goblin which has been stopped here stays stopped, whatever the host has to say
+        if (not previous.running or next.same_state(previous)) return;
+        state_word_.store(word, std::memory_order_release);
+        auto born = not is_settled(previous) and is_settled(next);
+        auto died = not previous.is_dead() and next.is_dead();
+        for (auto &group : groups_) {
+            if (born) group->member_born(completions);
+            if (died) group->member_died(completions);
+        }
+    }
+
+    /** The goblin has been destroyed, here or by its host */
+    void stop(completion_batch &completions) {
+        auto next = snapshot();
+        next.running = false;
+        ++next.generation;
+        update(next.pack(), completions);
+    }
+
+private:
+    using lock_type = std::unique_lock<std::mutex>;
+
+    static bool is_settled(goblin_snapshot const &s) {
+        return s.state != goblin_state_id::unborn or not s.running;
+    }
+
+    std::shared_ptr<detail::link_state> link_;
+    std::shared_ptr<remote_slot_map> slots_;
+    goblin_name name_;
+    goblin_handle handle_;
+    std::atomic<std::uint64_t> state_word_{0};
+    std::mutex mutex_;
+    boost::container::small_vector<std::shared_ptr<detail::group_state>, 1> groups_;
+};
+
+namespace detail {
+
+    inline bool link_state::handle_frame(wire_frame const &frame, boost::string_view, completion_batch &completions) {
+        switch (frame.op) {
+            case wire_op::complete: {
+                auto lock = lock_type(mutex_);
+                auto it = waiters_.find(frame.tag);
+                if (it == waiters_.end()) return false;
+                auto waiter = std::move(it->second);
+                waiters_.erase(it);
+                lock.unlock();
+                completions.add(std::move(waiter), frame.error());
+                return true;
+            }
+            case wire_op::state:
+                if (auto goblin = slots_->acquire(goblin_handle{frame.goblin})) {
+                    goblin->update(frame.tag, completions);
+                }
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    inline void link_state::handle_close(completion_batch &completions) {
+        auto lock = lock_type(mutex_);
+        lost_ = true;
+        auto waiters = std::move(waiters_);
+        waiters_.clear();
+        auto goblins = std::move(goblins_);
+        goblins_.clear();
+        lock.unlock();
+        for (auto &entry : waiters) completions.add(std::move(entry.second), goblin_error::host_lost);
+        for (auto key : goblins) {
+            if (auto goblin = slots_->acquire(goblin_handle{key})) goblin->stop(completions);
+        }
+    }
+}
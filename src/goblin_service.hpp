@@ -0,0 +1,406 @@
+#pragma once
+
+#include "config.hpp"
+#include "async_completion_handler.hpp"
+#include "worker_thread_service.hpp"
+#include "work_stealing_service.hpp"
+#include "goblin_name_generator.hpp"
+#include "goblin_impl.hpp"
+#include "goblin_registry.hpp"
+#include "goblin_allocation.hpp"
+#include "goblin_slot_map.hpp"
+#include "goblin_remote_impl.hpp"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct goblin_service : asio::detail::service_base<goblin_service> {
+    using impl_class = goblin_impl;
+
+    using implementation_proxy = impl_proxy<impl_class>;
+
+    /* specify the relationship between handle and implementation here */
+    using implementation_type = std::shared_ptr<impl_class>;
+
+    goblin_service(asio::io_service &owner) : asio::detail::service_base<goblin_service>(owner) {}
+
+    implementation_type construct() {
+
+        /*
+         * care - a goblin impl uses asio objects and therefore it's helpful to control it with a shared
+         *        pointer. However, the 'handle' class - goblin has unique ownership semantics.
+         *        It is convenient to separate the lifetime of the goblin from the lifetime of the
+         *        implementation. The death of a goblin handle can signal to the impl that it should start
+         *        an orderly shutdown.
+         */
+
+        auto id = next_goblin_id_.fetch_add(1, std::memory_order_relaxed);
+        return construct(id, name_generator_());
+    };
+
+    /** Construct count goblins at once.
+     * The ids and names are reserved in one step each, and the goblins are registered under one lock.
+     */
+    auto construct_n(std::size_t count) -> std::vector<implementation_type> {
+        std::vector<implementation_type> result;
+        result.reserve(count);
+        auto first_id = next_goblin_id_.fetch_add(count, std::memory_order_relaxed);
+        auto mode = execution_mode();
+        auto world = std::atomic_load(&world_);
+        auto id = first_id;
+        auto names = std::vector<goblin_name>();
+        names.reserve(count);
+        name_generator_.generate_n(count, [&](goblin_name name) { names.push_back(std::move(name)); });
+        registry_.insert_n(count, [&] {
+            auto proxy = make_pooled_proxy<impl_class>(get_worker_executor(id), id, std::move(names[id - first_id]),
+                                                       mode, world, kill_hub_, slots_);
+            ++id;
+            result.emplace_back(proxy, proxy->get_impl_ptr());
+            proxy->start();
+            return result.back();
+        });
+        return result;
+    }
+
+    /** Reserve count consecutive goblin ids and names without constructing any goblins, for a goblin_horde to
+     * construct them when they are first needed.
+     * @return the first id and the position of the first name in the name sequence
+     */
+    auto reserve(std::size_t count) -> std::pair<std::uint64_t, std::uint64_t> {
+        auto first_id = next_goblin_id_.fetch_add(count, std::memory_order_relaxed);
+        return {first_id, name_generator_.reserve(count)};
+    }
+
+    /** Construct the goblin with an id and name reserved by reserve() */
+    implementation_type construct(std::uint64_t id, goblin_name name) {
+        // the impl, the proxy and the proxy's control block share one block from the slab_pool
+        auto proxy = make_pooled_proxy<impl_class>(get_worker_executor(id), id, std::move(name), execution_mode(),
+                                                   std::atomic_load(&world_), kill_hub_, slots_);
+        // use the lifetime of the proxy to refer to the implementation
+        auto result = implementation_type {proxy, proxy->get_impl_ptr()};
+        registry_.insert(result);
+        proxy->start();
+        return result;
+    }
+
+    /** Choose how goblins constructed from now on will run their events.
+     * Goblins which already exist keep the mode they were constructed with.
+     */
+    void set_execution_mode(goblin_execution_mode mode) {
+        execution_mode_.store(mode);
+    }
+
+    auto execution_mode() const -> goblin_execution_mode {
+        return execution_mode_.load();
+    }
+
+    /** Keep a goblin_world of every goblin constructed from now on. Goblins which already exist are not in it.
+     * Calling it again has no effect.
+     */
+    void enable_world() {
+        auto expected = std::shared_ptr<goblin_world>();
+        std::atomic_compare_exchange_strong(&world_, &expected, std::make_shared<goblin_world>());
+    }
+
+    /** The goblin world, or nullptr if enable_world has not been called */
+    auto world() const -> goblin_world * {
+        return std::atomic_load(&world_).get();
+    }
+
+    /** Where the goblins report their kills. Subscribe with a goblin_kill_stream. */
+    auto kill_hub() -> goblin_kill_hub & {
+        return *kill_hub_;
+    }
+
+    /** Wrap a completion handler so that, when the goblin calls it, it is posted to this service's io_service.
+     * Completions go through the work-stealing scheduler, which is the io_service itself unless a
+     * work_stealing_pool is running it.
+     */
+    template<class Handler>
+    auto make_async_completion_handler(Handler &&handler) {
+        return async_completion_handler<std::decay_t<Handler>, work_stealing_service>(
+                completion_scheduler_, this->get_io_service(), std::forward<Handler>(handler));
+    }
+
+    /** Wrap a wait handler so that, when the goblin completes it, it is posted to this service's io_service in a
+     * batch with every other waiter the goblin completes at the same time.
+     */
+    template<class Handler>
+    auto make_waiter(Handler &&handler) -> goblin_waiter {
+        return goblin_waiter(completion_scheduler_, std::forward<Handler>(handler));
+    }
+
+    template<class WaitHandler>
+    auto async_spawn(implementation_type &impl, WaitHandler &&handler) {
+
+        asio::detail::async_result_init<
+                WaitHandler, void(boost::system::error_code)> init(
+                std::forward<WaitHandler>(handler));
+
+        impl->process_events(EventAddBirthHandler{make_waiter(std::move(init.handler))},
+                             GoblinBorn{*impl});
+
+        return init.result.get();
+    }
+
+    template<class WaitHandler>
+    auto on_birth(implementation_type &impl, WaitHandler &&handler) {
+
+        asio::detail::async_result_init<
+                WaitHandler, void(boost::system::error_code)> init(
+                std::forward<WaitHandler>(handler));
+
+        impl->process_event(EventAddBirthHandler{make_waiter(std::move(init.handler))});
+
+        //  service_impl_.async_wait(impl, init.handler);
+
+        return init.result.get();
+    }
+
+    /** cause a handler run when the goblin dies.
+     * The handler will be called exactly once.
+     * @tparam Handler
+     * @param impl
+     * @param handler
+     * @return
+     */
+
+    template<class WaitHandler>
+    auto wait_death(implementation_type &impl, WaitHandler &&handler) {
+
+        asio::detail::async_result_init<
+                WaitHandler, void(boost::system::error_code)> init(
+                std::forward<WaitHandler>(handler));
+
+        impl->process_event(EventAddDeathHandler{make_waiter(std::move(init.handler))});
+
+        //  service_impl_.async_wait(impl, init.handler);
+
+        return init.result.get();
+    }
+
+    /* The same operations on a goblin_ref's handle, which may be a goblin hosted by another process (see
+     * goblin_link). A stale handle reads as a goblin which was stopped before it was born: its name is empty, it
+     * is dead, events are ignored and waits complete with operation_aborted, as the waits of a destroyed goblin
+     * do. */
+
+    template<class WaitHandler>
+    auto async_spawn(goblin_handle handle, WaitHandler &&handler) {
+        return wait_on(handle, std::forward<WaitHandler>(handler), detail::wire_op::spawn,
+                       [](impl_class &impl, goblin_waiter waiter) {
+                           impl.process_events(EventAddBirthHandler{std::move(waiter)}, GoblinBorn{impl});
+                       });
+    }
+
+    template<class WaitHandler>
+    auto on_birth(goblin_handle handle, WaitHandler &&handler) {
+        return wait_on(handle, std::forward<WaitHandler>(handler), detail::wire_op::on_birth,
+                       [](impl_class &impl, goblin_waiter waiter) {
+                           impl.process_event(EventAddBirthHandler{std::move(waiter)});
+                       });
+    }
+
+    template<class WaitHandler>
+    auto wait_death(goblin_handle handle, WaitHandler &&handler) {
+        return wait_on(handle, std::forward<WaitHandler>(handler), detail::wire_op::wait_death,
+                       [](impl_class &impl, goblin_waiter waiter) {
+                           impl.process_event(EventAddDeathHandler{std::move(waiter)});
+                       });
+    }
+
+    auto name(goblin_handle handle) const -> goblin_name {
+        goblin_name result;
+        auto read = [&](auto &goblin) { result = goblin.name(); };
+        visit(handle, read, read);
+        return result;
+    }
+
+    auto snapshot(goblin_handle handle) const -> goblin_snapshot {
+        goblin_snapshot result;
+        auto read = [&](auto &goblin) { result = goblin.snapshot(); };
+        visit(handle, read, read);
+        return result;
+    }
+
+    bool is_dead(goblin_handle handle) const {
+        return snapshot(handle).is_dead();
+    }
+
+    auto current_state(goblin_handle handle) const -> goblin_state_id {
+        return snapshot(handle).state;
+    }
+
+    void be_born(goblin_handle handle) {
+        apply(handle, detail::wire_op::be_born, [](impl_class &impl) { impl.process_event(GoblinBorn{impl}); });
+    }
+
+    void die(goblin_handle handle) {
+        apply(handle, detail::wire_op::die, [](impl_class &impl) { impl.process_event(GoblinDies{impl}); });
+    }
+
+    /** Whether a handle still refers to a goblin. The answer may be out of date by the time the caller sees it. */
+    bool contains(goblin_handle handle) const {
+        return handle.is_remote() ? remote_slots_->contains(handle) : slots_->contains(handle);
+    }
+
+    /** Make a goblin a member of a group. A goblin which no longer exists joins as if destroyed at once. */
+    void join_group(implementation_type const &impl, std::shared_ptr<detail::group_state> group) {
+        impl->join_group(std::move(group));
+    }
+
+    void join_group(goblin_handle handle, std::shared_ptr<detail::group_state> group) {
+        auto join = [&](auto &goblin) { goblin.join_group(group); };
+        if (not visit(handle, join, join)) group->member_joined(true, true);
+    }
+
+    /** The remote goblins reached through this service's links. Shared with the links and the goblins. */
+    auto remote_slots() const -> std::shared_ptr<remote_slot_map> const & {
+        return remote_slots_;
+    }
+
+    auto name(implementation_type const &impl) const -> goblin_name {
+        return impl->name();
+    }
+
+    auto is_dead(implementation_type const &impl) const {
+        return impl->is_dead();
+    }
+
+    auto current_state(implementation_type const &impl) const {
+        return impl->current_state();
+    }
+
+    auto snapshot(implementation_type const &impl) const {
+        return impl->snapshot();
+    }
+
+    auto be_born(implementation_type &impl) {
+        // let's implement this as a background job
+        impl->process_event(GoblinBorn{*impl});
+    }
+
+    auto die(implementation_type &impl) {
+        impl->process_event(GoblinDies{*impl});
+    }
+
+    /** Give birth to every goblin in a range of goblins, goblin_refs or implementations.
+     * The goblins' completions are dispatched together once all of them have been born.
+     */
+    template<class Iterator>
+    void spawn_all(Iterator first, Iterator last) {
+        completion_batch completions;
+        for (; first != last; ++first) {
+            apply(implementation_of(*first), detail::wire_op::be_born, [&](impl_class &impl) {
+                impl.process_event(GoblinBorn{impl}, completions);
+            });
+        }
+        completions.dispatch();
+    }
+
+    /** Kill every goblin in a range of goblins, goblin_refs or implementations.
+     * The death waiters of all of them are completed in one batch.
+     */
+    template<class Iterator>
+    void die_all(Iterator first, Iterator last) {
+        completion_batch completions;
+        for (; first != last; ++first) {
+            apply(implementation_of(*first), detail::wire_op::die, [&](impl_class &impl) {
+                impl.process_event(GoblinDies{impl}, completions);
+            });
+        }
+        completions.dispatch();
+    }
+
+    auto registry() -> goblin_registry<impl_class> & {
+        return registry_;
+    }
+
+private:
+
+    static auto implementation_of(implementation_type &impl) -> implementation_type & {
+        return impl;
+    }
+
+    static auto implementation_of(implementation_type const &impl) -> implementation_type const & {
+        return impl;
+    }
+
+    template<class Handle>
+    static auto implementation_of(Handle &handle) -> decltype(handle.get_implementation()) {
+        return handle.get_implementation();
+    }
+
+    /** Call local with the goblin a handle refers to, or remote with the remote goblin, pinned for the duration.
+     * @return false if the handle is stale
+     */
+    template<class Local, class Remote>
+    bool visit(goblin_handle handle, Local &&local, Remote &&remote) const {
+        if (handle.is_remote()) {
+            auto goblin = remote_slots_->acquire(handle);
+            if (goblin) remote(*goblin);
+            return bool(goblin);
+        }
+        auto impl = slots_->acquire(handle);
+        if (impl) local(*impl);
+        return bool(impl);
+    }
+
+    template<class F>
+    static void apply(implementation_type const &impl, detail::wire_op, F &&f) {
+        f(*impl);
+    }
+
+    /** Call f with the goblin a handle refers to, or send a remote goblin the event op */
+    template<class F>
+    void apply(goblin_handle handle, detail::wire_op op, F &&f) const {
+        visit(handle, std::forward<F>(f), [op](remote_goblin_impl &goblin) { goblin.send(op); });
+    }
+
+    /** Start a wait on the goblin a handle refers to, or complete it with operation_aborted if there is none.
+     * A remote goblin is sent op instead.
+     */
+    template<class WaitHandler, class Start>
+    auto wait_on(goblin_handle handle, WaitHandler &&handler, detail::wire_op op, Start &&start) {
+
+        asio::detail::async_result_init<
+                WaitHandler, void(boost::system::error_code)> init(
+                std::forward<WaitHandler>(handler));
+
+        auto waiter = make_waiter(std::move(init.handler));
+        auto found = visit(handle,
+                           [&](impl_class &impl) { start(impl, std::move(waiter)); },
+                           [&](remote_goblin_impl &goblin) { goblin.wait(op, std::move(waiter)); });
+        if (not found) {
+            completion_batch completions;
+            completions.add(std::move(waiter), asio::error::operation_aborted);
+            completions.dispatch();
+        }
+
+        return init.result.get();
+    }
+
+    /** The worker executor of the shard which will own the goblin with the given id */
+    auto get_worker_executor(std::uint64_t goblin_id) const -> asio::io_service & {
+        return worker_service_.get_worker_executor(goblin_id);
+    }
+
+    void shutdown_service() override {
+
+    }
+
+    worker_thread_service &worker_service_ = asio::use_service<worker_thread_service>(get_io_service());
+    work_stealing_service &completion_scheduler_ = asio::use_service<work_stealing_service>(get_io_service());
+    goblin_registry<impl_class> registry_;
+    goblin_name_generator name_generator_{};
+    std::atomic<goblin_execution_mode> execution_mode_{goblin_execution_mode::locked};
+    std::atomic<std::uint64_t> next_goblin_id_{0};
+    std::shared_ptr<goblin_world> world_;
+    std::shared_ptr<goblin_kill_hub> kill_hub_ = std::make_shared<goblin_kill_hub>();
+    // shared with the goblins, which may outlive the service
+    std::shared_ptr<goblin_slot_map> slots_ = std::make_shared<goblin_slot_map>();
+    std::shared_ptr<remote_slot_map> remote_slots_ =
+            std::make_shared<remote_slot_map>(std::uint32_t(goblin_handle::remote_index));
+
+};
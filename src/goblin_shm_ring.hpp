@@ -0,0 +1,261 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <boost/utility/string_view.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace detail {
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2 and ATOMIC_INT_LOCK_FREE == 2,
+                  "shared-memory rings need lock-free atomics, which are address-free");
+
+    /** Sleep while word holds expected, until woken by futex_wake. Shared between processes, so not private. */
+    inline void futex_wait(std::atomic<std::uint32_t> &word, std::uint32_t expected) {
+#if defined(__linux__)
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+#else
+        if (word.load() == expected) std::this_thread::sleep_for(std::chrono::microseconds(50));
+#endif
+    }
+
+    inline void futex_wake(std::atomic<std::uint32_t> &word) {
+#if defined(__linux__)
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+    }
+
+    /** A single-producer, single-consumer byte ring in shared memory.
+     *
+     * The producer copies a record in at the tail and publishes it by advancing the tail; the consumer reads it
+     * where it lies and frees it by advancing the head. Positions only grow, and are taken modulo the capacity.
+     * A consumer with nothing to read sets sleeping and waits on it as a futex, and a producer only makes the
+     * wake-up syscall if it finds sleeping set, so a busy consumer costs its producers nothing but the stores.
+     *
+     * A producer never waits for room. If a record does not fit it sets space_wanted, and the consumer, having
+     * freed some, clears it and tells the producer's side through the ring running the other way.
+     */
+    struct shm_ring {
+        static constexpr std::size_t capacity = std::size_t(1) << 20;
+
+        /** Append a record made of a header and a payload, if there is room for it.
+         * @return false, having written nothing, if there is not
+         */
+        bool try_write(char const *header, std::size_t header_size, boost::string_view payload) {
+            auto size = header_size + payload.size();
+            auto t = tail.load(std::memory_order_relaxed);
+            if (not has_room(size)) return false;
+            copy_in(t, header, header_size);
+            copy_in(t + header_size, payload.data(), payload.size());
+            tail.store(t + size, std::memory_order_seq_cst);
+            wake_consumer();
+            return true;
+        }
+
+        /** Whether a record of size bytes would fit. Only meaningful to the producer. */
+        bool has_room(std::size_t size) const {
+            auto t = tail.load(std::memory_order_relaxed);
+            return capacity - (t - head.load(std::memory_order_seq_cst)) >= size;
+        }
+
+        void wake_consumer() {
+            if (sleeping.load(std::memory_order_seq_cst)) {
+                sleeping.store(0, std::memory_order_relaxed);
+                futex_wake(sleeping);
+            }
+        }
+
+        void copy_out(std::uint64_t position, char *out, std::size_t size) const {
+            auto offset = std::size_t(position % capacity);
+            auto first = std::min(size, capacity - offset);
+            std::memcpy(out, data + offset, first);
+            std::memcpy(out + first, data, size - first);
+        }
+
+        /** The record at position, where it lies if it does not wrap, otherwise copied into scratch */
+        auto view(std::uint64_t position, std::size_t size, std::string &scratch) const -> boost::string_view {
+            auto offset = std::size_t(position % capacity);
+            if (offset + size <= capacity) return boost::string_view(data + offset, size);
+            scratch.resize(size);
+            copy_out(position, &scratch[0], size);
+            return scratch;
+        }
+
+        /** Sleep until the tail moves past position, or ready() is true, or a spurious wake-up.
+         * ready() is checked after sleeping is set, so whatever makes it true need only call wake_consumer(). */
+        template<class Ready>
+        void wait(std::uint64_t position, Ready ready) {
+            sleeping.store(1, std::memory_order_seq_cst);
+            if (tail.load(std::memory_order_seq_cst) != position or ready()) {
+                sleeping.store(0, std::memory_order_relaxed);
+                return;
+            }
+            futex_wait(sleeping, 1);
+        }
+
+        /** Free everything before position, and tell the producer if it is waiting for room.
+         * @param reverse the ring running the other way, whose consumer is this ring's producer
+         */
+        void release(std::uint64_t position, shm_ring &reverse) {
+            head.store(position, std::memory_order_seq_cst);
+            if (space_wanted.load(std::memory_order_seq_cst)) {
+                space_wanted.store(0, std::memory_order_relaxed);
+                reverse.wake_consumer();
+            }
+        }
+
+        alignas(64) std::atomic<std::uint64_t> tail;
+        alignas(64) std::atomic<std::uint64_t> head;
+        alignas(64) std::atomic<std::uint32_t> sleeping;
+        std::atomic<std::uint32_t> space_wanted;
+        alignas(64) char data[capacity];
+
+    private:
+        void copy_in(std::uint64_t position, char const *in, std::size_t size) {
+            auto offset = std::size_t(position % capacity);
+            auto first = std::min(size, capacity - offset);
+            std::memcpy(data + offset, in, first);
+            std::memcpy(data, in + first, size - first);
+        }
+    };
+
+    /** A mapped file in /dev/shm holding one ring in each direction between a goblin_link (side 0) and its host
+     * (side 1). The side which creates it removes the file when done with it; the other may remove it as soon as
+     * it has mapped it.
+     */
+    class shm_segment {
+    public:
+        struct layout {
+            alignas(64) std::atomic<std::uint32_t> closed;
+            shm_ring rings[2];
+        };
+
+        /** Create a new segment with a name unique to this process.
+         * Throws boost::system::system_error if it cannot.
+         */
+        static auto create() -> std::unique_ptr<shm_segment> {
+            static std::atomic<std::uint32_t> sequence{0};
+            auto name = "goblins-" + std::to_string(::getpid()) + "-" + std::to_string(sequence++);
+            auto segment = std::unique_ptr<shm_segment>(new shm_segment(name, true));
+            // zero-filled by ftruncate, which is a valid initial state for every member
+            return segment;
+        }
+
+        /** Map a segment created by the other side, and remove its file.
+         * The name comes from the peer, so it must be one create() could have made, and the file must be a
+         * regular file, not a link, big enough to hold the layout. Throws boost::system::system_error if not, or
+         * if it cannot be mapped.
+         */
+        static auto open(std::string const &name) -> std::unique_ptr<shm_segment> {
+            if (not is_valid_name(name)) {
+                errno = EINVAL;
+                fail("goblin shared memory: bad segment name");
+            }
+            auto segment = std::unique_ptr<shm_segment>(new shm_segment(name, false));
+            ::unlink(path_of(name).c_str());
+            return segment;
+        }
+
+        shm_segment(shm_segment const &) = delete;
+
+        shm_segment &operator=(shm_segment const &) = delete;
+
+        ~shm_segment() {
+            ::munmap(layout_, sizeof(layout));
+            if (creator_) ::unlink(path_of(name_).c_str());
+        }
+
+        auto name() const -> std::string const & { return name_; }
+
+        /** The ring a side reads from */
+        auto inbound(int side) -> shm_ring & { return layout_->rings[1 - side]; }
+
+        auto outbound(int side) -> shm_ring & { return layout_->rings[side]; }
+
+        auto closed() -> std::atomic<std::uint32_t> & { return layout_->closed; }
+
+        /** Tell both sides to stop, and wake their consumers */
+        void close() {
+            layout_->closed.store(1);
+            for (auto &ring : layout_->rings) {
+                ring.sleeping.store(0);
+                futex_wake(ring.sleeping);
+            }
+        }
+
+    private:
+        shm_segment(std::string name, bool creator) : name_(std::move(name)), creator_(creator) {
+            auto path = path_of(name_);
+            auto fd = ::open(path.c_str(), creator ? O_RDWR | O_CREAT | O_EXCL : O_RDWR | O_NOFOLLOW, 0600);
+            if (fd < 0) fail("goblin shared memory: open");
+            if (creator and ::ftruncate(fd, sizeof(layout)) != 0) {
+                ::close(fd);
+                ::unlink(path.c_str());
+                fail("goblin shared memory: ftruncate");
+            }
+            struct stat status;
+            if (not creator and (::fstat(fd, &status) != 0 or not S_ISREG(status.st_mode)
+                                 or std::uint64_t(status.st_size) < sizeof(layout))) {
+                ::close(fd);
+                errno = EINVAL;
+                fail("goblin shared memory: not a segment");
+            }
+            auto address = ::mmap(nullptr, sizeof(layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (address == MAP_FAILED) {
+                if (creator) ::unlink(path.c_str());
+                fail("goblin shared memory: mmap");
+            }
+            layout_ = static_cast<layout *>(address);
+        }
+
+        /** True if name has the form goblins-<pid>-<sequence> which create() gives it */
+        static bool is_valid_name(std::string const &name) {
+            static char const prefix[] = "goblins-";
+            auto const prefix_size = sizeof(prefix) - 1;
+            if (name.size() <= prefix_size or name.compare(0, prefix_size, prefix) != 0) return false;
+            auto digits = [](std::string const &s, std::size_t first, std::size_t last) {
+                return first < last and std::all_of(s.begin() + first, s.begin() + last,
+                                                    [](char c) { return c >= '0' and c <= '9'; });
+            };
+            auto dash = name.find('-', prefix_size);
+            return dash != std::string::npos and digits(name, prefix_size, dash)
+                   and digits(name, dash + 1, name.size());
+        }
+
+        static auto path_of(std::string const &name) -> std::string {
+#if defined(__linux__)
+            return "/dev/shm/" + name;
+#else
+            return "/tmp/" + name;
+#endif
+        }
+
+        [[noreturn]] static void fail(char const *what) {
+            throw boost::system::system_error(asio::error_code(errno, boost::system::system_category()), what);
+        }
+
+        std::string name_;
+        bool creator_;
+        layout *layout_ = nullptr;
+    };
+}
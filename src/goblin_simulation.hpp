@@ -0,0 +1,111 @@
+#pragma once
+
+#include "config.hpp"
+#include "timing_wheel_service.hpp"
+#include "virtual_clock_service.hpp"
+#include "worker_thread_service.hpp"
+
+#include <memory>
+#include <stdexcept>
+
+/** Runs an io_service, and every goblin on it, on the calling thread in virtual time.
+ *
+ * Constructing a simulation gives the io_service a virtual_clock_service and an inline worker executor, so
+ * goblins, their completions and their kill timers all run on the io_service itself. run() then alternates
+ * between running every ready handler and jumping the clock straight to the next timer, so five seconds of a
+ * goblin's life take as long as the handlers do, not five seconds. Since one thread runs one FIFO queue, the
+ * handlers run in the same order every time.
+ *
+ * Only timers on the io_service's timing wheel (wheel_timer) keep virtual time. An asio timer still waits in
+ * real time, and a simulation which only has one pending stops running when it has nothing else to do.
+ *
+ * The io_service is only stopped by a call to stop(), never for want of work, while the simulation exists.
+ *
+ * Must be constructed before anything uses the io_service's worker threads or timing wheel, i.e. before the
+ * first goblin or wheel_timer.
+ */
+class goblin_simulation {
+public:
+    using clock_type = virtual_clock_service::clock_type;
+    using time_point = virtual_clock_service::time_point;
+    using duration = virtual_clock_service::duration;
+
+    explicit goblin_simulation(asio::io_service &owner)
+            : owner_(owner),
+              clock_(install_clock(owner)),
+              wheel_(asio::use_service<timing_wheel_service>(owner)),
+              work_(owner) {}
+
+    goblin_simulation(goblin_simulation const &) = delete;
+
+    goblin_simulation &operator=(goblin_simulation const &) = delete;
+
+    auto now() const -> time_point { return clock_.now(); }
+
+    /** The virtual time which has passed since the simulation was constructed */
+    auto elapsed() const -> duration { return clock_.elapsed(); }
+
+    /** Run until there are no ready handlers and no pending timers, or the io_service is stopped.
+     * @return the number of handlers run
+     */
+    auto run() -> std::size_t {
+        return run_to(nullptr);
+    }
+
+    /** Run, as run() does, until the clock reaches when. The clock is then left at when, even if there was
+     * nothing to do before it.
+     */
+    auto run_until(time_point when) -> std::size_t {
+        auto result = run_to(&when);
+        clock_.advance_to(when);
+        return result;
+    }
+
+    auto run_for(duration d) -> std::size_t {
+        return run_until(now() + d);
+    }
+
+    /** Run every ready handler without moving the clock */
+    auto poll() -> std::size_t {
+        std::size_t result = 0;
+        while (not owner_.stopped()) {
+            auto ran = owner_.poll();
+            if (not ran) break;
+            result += ran;
+        }
+        return result;
+    }
+
+private:
+    static auto install_clock(asio::io_service &owner) -> virtual_clock_service & {
+        if (asio::has_service<timing_wheel_service>(owner)) {
+            throw std::logic_error("goblin_simulation: the io_service's timing wheel already runs in real time");
+        }
+        // throws asio::service_already_exists if a goblin has already been constructed
+        install_worker_threads(owner, worker_thread_options::inline_only());
+        auto service = std::make_unique<virtual_clock_service>(owner);
+        asio::add_service(owner, service.get());
+        return *service.release();
+    }
+
+    auto run_to(time_point const *limit) -> std::size_t {
+        std::size_t result = 0;
+        for (;;) {
+            result += poll();
+            if (owner_.stopped()) break;
+
+            time_point due;
+            if (not wheel_.next_due(due) or (limit and due > *limit)) break;
+            clock_.advance_to(due);
+            // turned from the queue, like the asio timer would, so that the order is the queue's
+            owner_.post([this] { wheel_.on_tick(); });
+        }
+        return result;
+    }
+
+    asio::io_service &owner_;
+    virtual_clock_service &clock_;
+    timing_wheel_service &wheel_;
+    // running out of handlers only means it is time to turn the wheel, so the io_service must not stop itself
+    asio::io_service::work work_;
+};
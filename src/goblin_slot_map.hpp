@@ -0,0 +1,200 @@
+#pragma once
+
+#include "chunk_directory.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+struct goblin_impl;
+
+/** A generational index into a goblin_slot_map: the slot in the low 32 bits, its generation in the high 32.
+ * A default-constructed handle refers to nothing. Trivially copyable, so it can be passed anywhere for free.
+ * The top bit of the index marks a goblin hosted by another process (see goblin_link).
+ */
+struct goblin_handle {
+    static constexpr std::uint32_t remote_index = 0x80000000u;
+
+    std::uint64_t value = 0;
+
+    auto index() const -> std::uint32_t { return std::uint32_t(value); }
+
+    bool is_remote() const { return (index() & remote_index) != 0; }
+
+    auto generation() const -> std::uint32_t { return std::uint32_t(value >> 32); }
+
+    explicit operator bool() const { return value != 0; }
+
+    bool operator==(goblin_handle const &r) const { return value == r.value; }
+
+    bool operator!=(goblin_handle const &r) const { return value != r.value; }
+
+    static auto make(std::uint32_t index, std::uint32_t generation) -> goblin_handle {
+        return goblin_handle{std::uint64_t(index) | (std::uint64_t(generation) << 32)};
+    }
+};
+
+/** The goblins of a goblin_service, indexed by goblin_handle. T is goblin_impl, or remote_goblin_impl for the
+ * goblins a service reaches through links, whose handles carry goblin_handle::remote_index.
+ *
+ * Each slot has one 64-bit word: the generation of the goblin in it in the high half, and the number of callers
+ * using that goblin in the low half. A caller pins a slot with a single fetch_add, which tells it at the same
+ * time whether its handle is current; if it is, the goblin cannot be retired until the caller unpins it. Retiring
+ * a goblin advances the generation, so no new pin can succeed, then waits for the pins already taken to go.
+ *
+ * Slots live in fixed-size chunks, in a chunk_directory, which are never moved or freed while the map exists, so a
+ * stale handle can always be checked safely.
+ */
+template<class T>
+class basic_slot_map {
+public:
+    static constexpr std::size_t chunk_size = 4096;
+    static constexpr std::size_t max_chunks = 65536;
+
+    /** Keeps a goblin from being retired while it is in use. Empty if the handle was stale. */
+    class pin {
+    public:
+        pin() = default;
+
+        pin(pin &&other) noexcept : word_(other.word_), impl_(other.impl_) {
+            other.word_ = nullptr;
+            other.impl_ = nullptr;
+        }
+
+        pin &operator=(pin &&) = delete;
+
+        ~pin() {
+            if (word_) word_->fetch_sub(1, std::memory_order_release);
+        }
+
+        auto get() const -> T * { return impl_; }
+
+        auto operator->() const -> T * { return impl_; }
+
+        auto operator*() const -> T & { return *impl_; }
+
+        explicit operator bool() const { return impl_ != nullptr; }
+
+    private:
+        friend basic_slot_map;
+
+        pin(std::atomic<std::uint64_t> *word, T *impl) : word_(word), impl_(impl) {}
+
+        std::atomic<std::uint64_t> *word_ = nullptr;
+        T *impl_ = nullptr;
+    };
+
+    /** @param tag goblin_handle::remote_index if the map holds remote goblins, otherwise 0 */
+    explicit basic_slot_map(std::uint32_t tag = 0) : tag_(tag) {}
+
+    basic_slot_map(basic_slot_map const &) = delete;
+
+    basic_slot_map &operator=(basic_slot_map const &) = delete;
+
+    /** Give a goblin a slot */
+    auto insert(T *impl) -> goblin_handle {
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        std::uint32_t index;
+        if (not free_slots_.empty()) {
+            index = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            index = std::uint32_t(size_);
+            if (index % chunk_size == 0) {
+                if (index / chunk_size >= max_chunks) throw std::length_error("basic_slot_map is full");
+                chunks_.add(index / chunk_size);
+            }
+            ++size_;
+        }
+        auto &s = slot_at(index);
+        s.impl.store(impl, std::memory_order_relaxed);
+        // the generation was advanced when the slot was last retired, and no pin can be held on it
+        auto generation = std::uint32_t(s.word.load(std::memory_order_relaxed) >> 32);
+        return goblin_handle::make(index | tag_, generation);
+    }
+
+    /** Pin the goblin a handle refers to, if the handle is current */
+    auto acquire(goblin_handle handle) const -> pin {
+        if (not owns(handle)) return {};
+        auto &s = slot_at(position(handle));
+        auto word = s.word.fetch_add(1, std::memory_order_acquire);
+        if (std::uint32_t(word >> 32) != handle.generation()) {
+            s.word.fetch_sub(1, std::memory_order_relaxed);
+            return {};
+        }
+        return pin(&s.word, s.impl.load(std::memory_order_relaxed));
+    }
+
+    /** Whether a handle is current. The answer may be out of date by the time the caller sees it. */
+    bool contains(goblin_handle handle) const {
+        if (not owns(handle)) return false;
+        auto word = slot_at(position(handle)).word.load(std::memory_order_acquire);
+        return std::uint32_t(word >> 32) == handle.generation();
+    }
+
+    /** Make a handle stale and free its slot once nobody has it pinned. Does nothing if it is stale already.
+     * Must not be called by a thread which has the goblin pinned.
+     */
+    void retire(goblin_handle handle) {
+        if (not owns(handle)) return;
+        auto &s = slot_at(position(handle));
+        auto word = s.word.load(std::memory_order_relaxed);
+        std::uint64_t next;
+        do {
+            if (std::uint32_t(word >> 32) != handle.generation()) return;
+            next = (std::uint64_t(next_generation(handle.generation())) << 32) | (word & pin_mask);
+        } while (not s.word.compare_exchange_weak(word, next, std::memory_order_acq_rel));
+
+        // pins taken under the old generation are held by callers still using the goblin
+        while (s.word.load(std::memory_order_acquire) & pin_mask) std::this_thread::yield();
+        s.impl.store(nullptr, std::memory_order_relaxed);
+
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        free_slots_.push_back(position(handle));
+    }
+
+    /** The number of slots ever used, in use or free */
+    auto capacity() const -> std::size_t { return size_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr std::uint64_t pin_mask = 0xffffffffull;
+
+    struct slot {
+        // generation << 32 | pins. Generations start at 1, so that no handle is ever zero.
+        std::atomic<std::uint64_t> word{std::uint64_t(1) << 32};
+        std::atomic<T *> impl{nullptr};
+    };
+
+    struct chunk {
+        slot slots[chunk_size];
+    };
+
+    static auto next_generation(std::uint32_t generation) -> std::uint32_t {
+        return generation + 1 ? generation + 1 : 1;
+    }
+
+    auto position(goblin_handle handle) const -> std::uint32_t {
+        return handle.index() & ~goblin_handle::remote_index;
+    }
+
+    bool owns(goblin_handle handle) const {
+        return handle and (handle.index() & goblin_handle::remote_index) == tag_ and position(handle) < capacity();
+    }
+
+    auto slot_at(std::uint32_t index) const -> slot & {
+        return chunks_[index / chunk_size].slots[index % chunk_size];
+    }
+
+    std::uint32_t const tag_;
+    std::mutex mutex_;
+    std::vector<std::uint32_t> free_slots_;
+    std::atomic<std::size_t> size_{0};
+    chunk_directory<chunk, max_chunks> chunks_;
+};
+
+using goblin_slot_map = basic_slot_map<goblin_impl>;
@@ -1,11 +1,20 @@
 #pragma once
 
 #include "config.hpp"
+#include "completion_batch.hpp"
+#include "goblin_kills.hpp"
+#include "goblin_metrics.hpp"
+#include "goblin_trace.hpp"
+#include "table_state_machine.hpp"
+#include "timing_wheel_service.hpp"
+#include "unique_handler.hpp"
 #include <boost/msm/front/state_machine_def.hpp>
 #include <boost/msm/back/state_machine.hpp>
 #include <boost/msm/front/functor_row.hpp>
 #include <boost/msm/front/common_states.hpp>
 #include <boost/optional.hpp>
+#include <boost/container/small_vector.hpp>
+#include <cstdint>
 #include <iostream>
 
 #include "goblin_error.hpp"
@@ -31,17 +40,68 @@ struct GoblinDies {
     goblin_impl &impl;
 };
 
+/* msm passes events by const reference; the handler is mutable so that it can be moved into the goblin */
+
 struct EventAddBirthHandler {
-    std::function<void(asio::error_code const &)> handler_function;
+    mutable goblin_waiter handler_function;
 };
 
 struct EventAddDeathHandler {
-    std::function<void(asio::error_code const &)> handler_function;
+    mutable goblin_waiter handler_function;
 };
 
+template<> struct trace_event_of<GoblinBorn> : std::integral_constant<trace_event, trace_event::born> {};
+template<> struct trace_event_of<GoblinKilledSomeone>
+        : std::integral_constant<trace_event, trace_event::killed_someone> {};
+template<> struct trace_event_of<GoblinDies> : std::integral_constant<trace_event, trace_event::dies> {};
+template<> struct trace_event_of<EventAddBirthHandler>
+        : std::integral_constant<trace_event, trace_event::add_birth_handler> {};
+template<> struct trace_event_of<EventAddDeathHandler>
+        : std::integral_constant<trace_event, trace_event::add_death_handler> {};
+
 /** A flag indicating that a goblin has died */
 struct PositivelyDead {};
 
+/** The states of a goblin as seen from outside its state machine */
+enum class goblin_state_id : std::uint8_t {
+    unborn,
+    killing_folk,
+    dead,
+};
+
+/** A goblin's state as published after every transition. It packs into one 64-bit word so that it can be read
+ * from any thread, without locking, and always be self-consistent.
+ */
+struct goblin_snapshot {
+    goblin_state_id state = goblin_state_id::unborn;
+    bool running = false;
+    bool dead = false;
+    /** incremented, modulo 2^32, every time any of the above change */
+    std::uint32_t generation = 0;
+
+    bool is_dead() const { return (not running) or dead; }
+
+    bool same_state(goblin_snapshot const &r) const {
+        return state == r.state and running == r.running and dead == r.dead;
+    }
+
+    auto pack() const -> std::uint64_t {
+        return std::uint64_t(state)
+               | (std::uint64_t(running) << 8)
+               | (std::uint64_t(dead) << 9)
+               | (std::uint64_t(generation) << 32);
+    }
+
+    static auto unpack(std::uint64_t word) -> goblin_snapshot {
+        goblin_snapshot result;
+        result.state = goblin_state_id(word & 0xff);
+        result.running = (word >> 8) & 1;
+        result.dead = (word >> 9) & 1;
+        result.generation = std::uint32_t(word >> 32);
+        return result;
+    }
+};
+
 struct goblin_handler {
     template<class EVT, class FSM, class SourceState, class TargetState>
     void operator()(EVT const &event, FSM &fsm, SourceState &source, TargetState &target) const {
@@ -53,8 +113,15 @@ struct goblin_handler {
 };
 
 
-struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
-    using wait_signal = std::function<void(asio::error_code const &ec)>;
+struct goblin_state_ : msmf::state_machine_def<goblin_state_>, goblin_state_timer {
+    using wait_signal = goblin_waiter;
+
+    /** Space for this many waiters of each kind is reserved in the goblin itself */
+    static constexpr std::size_t inline_waiters = 1;
+    using wait_signals = boost::container::small_vector<wait_signal, inline_waiters>;
+
+    // events are never processed re-entrantly, and a message queue would require them to be copyable
+    using no_message_queue = int;
 
     using birth_signal = wait_signal;
     using death_signal = wait_signal;
@@ -63,19 +130,22 @@ struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
 
         template<class Event, class FSM>
         void on_entry(Event const &event, FSM &fsm) {
+            fsm.state_entered(goblin_state_id::unborn);
         };
 
         template<class Event, class FSM>
         void on_exit(Event const &event, FSM &fsm) {
+            fsm.state_left(goblin_state_id::unborn);
         };
 
     };
 
     struct KillingFolk : msmf::state<> {
-        boost::optional<asio::deadline_timer> kill_timer_;
+        boost::optional<wheel_timer> kill_timer_;
 
         template<class Event, class FSM>
         void on_entry(Event const &, FSM &fsm) {
+            fsm.state_entered(goblin_state_id::killing_folk);
             fsm.fire_birth_handlers(asio::error_code());
         }
 
@@ -83,8 +153,9 @@ struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
         void on_entry(GoblinBorn const &event, FSM &fsm);
 
         template<class Event, class FSM>
-        void on_exit(Event const &, FSM &) {
+        void on_exit(Event const &, FSM &fsm) {
             kill_timer_.reset();
+            fsm.state_left(goblin_state_id::killing_folk);
         }
 
     };
@@ -95,8 +166,14 @@ struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
 
         template<class Event, class FSM>
         void on_entry(Event const &, FSM &fsm) {
+            fsm.state_entered(goblin_state_id::dead);
             fsm.fire_death_handlers(asio::error_code());
         }
+
+        template<class Event, class FSM>
+        void on_exit(Event const &, FSM &fsm) {
+            fsm.state_left(goblin_state_id::dead);
+        }
     };
 
     struct add_birth_handler : goblin_handler {
@@ -109,12 +186,12 @@ struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
 
         template<class FSM>
         void operator()(EventAddBirthHandler const &event, FSM &fsm, KillingFolk &source, KillingFolk &target) const {
-            event.handler_function(asio::error_code());
+            fsm.completions.add(std::move(event.handler_function), asio::error_code());
         }
 
         template<class FSM>
         void operator()(EventAddBirthHandler const &event, FSM &fsm, Dead &source, Dead &target) const {
-            event.handler_function(goblin_error::actually_dead);
+            fsm.completions.add(std::move(event.handler_function), goblin_error::actually_dead);
         }
 
     };
@@ -134,11 +211,23 @@ struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
 
         template<class FSM>
         void operator()(EventAddDeathHandler const &event, FSM &fsm, Dead &source, Dead &target) const {
-            event.handler_function(asio::error_code());
+            fsm.completions.add(std::move(event.handler_function), asio::error_code());
         }
 
     };
 
+    struct report_kill {
+        template<class FSM>
+        void operator()(GoblinKilledSomeone const &, FSM &fsm, KillingFolk &source, KillingFolk &) const {
+            if (not fsm.kills or not fsm.kills->has_subscribers()) return;
+            // the kill timer's clock, which is virtual in a simulation
+            auto when = source.kill_timer_ ? source.kill_timer_->now() : std::chrono::steady_clock::now();
+            // published with the completions, once the lock is released, since a full subscriber may block
+            fsm.completions.add([hub = fsm.kills, kill = goblin_kill{fsm.goblin_id, when}](asio::error_code const &) {
+                hub->publish(kill);
+            }, asio::error_code());
+        }
+    };
 
     template<class Fsm, class Event>
     void on_exit(Fsm &fsm, Event const &event) {
@@ -161,6 +250,10 @@ struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
             msmf::Row<KillingFolk, GoblinDies, Dead>,
             msmf::Row<Dead, GoblinDies, msmf::none>,
 
+            msmf::Row<KillingFolk, GoblinKilledSomeone, msmf::none, report_kill>,
+            // a kill timer may fire just as the goblin dies
+            msmf::Row<Dead, GoblinKilledSomeone, msmf::none>,
+
             msmf::Row<Unborn, GoblinBorn, KillingFolk>
     > {
     };
@@ -173,22 +266,45 @@ struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
     // Default no-transition handler. Can be replaced in the Derived SM class.
     template<class FSM, class Event>
     void no_transition(Event const &e, FSM &, int n) {
+        auto state = std::uint8_t(state_id_of<FSM>(n));
+        goblin_trace::record(goblin_id, trace_event::no_transition, state, state);
         std::cerr << "no transition state = " << n << " for " << typeid(e).name() << std::endl;
     }
 
     // default exception handler. Can be replaced in the Derived SM class.
     template<class FSM, class Event>
-    void exception_caught(Event const &ev, FSM &, std::exception &e) {
+    void exception_caught(Event const &ev, FSM &fsm, std::exception &e) {
+        auto state = std::uint8_t(state_id_of<FSM>(fsm.current_state()[0]));
+        goblin_trace::record(goblin_id, trace_event::exception, state, state);
         std::cerr << "exception caught = " << e.what() << " for " << typeid(ev).name() << std::endl;
     }
 
-    void fire_wait_handlers(std::vector<wait_signal> &signals, asio::error_code const &ec) {
+    /** Map the id the back-end FSM gives a state to the goblin_state_id seen from outside */
+    template<class FSM>
+    static auto state_id_of(int fsm_state) -> goblin_state_id {
+        if (fsm_state == fsm_state_id<FSM, KillingFolk>::value) {
+            return goblin_state_id::killing_folk;
+        }
+        if (fsm_state == fsm_state_id<FSM, Dead>::value) {
+            return goblin_state_id::dead;
+        }
+        return goblin_state_id::unborn;
+    }
+
+    /** Queue the waiters' completions. They are dispatched by whoever took the lock, once it is released. */
+    void fire_wait_handlers(wait_signals &signals, asio::error_code const &ec) {
+        goblin_metrics::waiters_fired(signals.size());
         for (auto &sig : signals) {
-            sig(ec);
+            completions.add(std::move(sig), ec);
         }
         signals.clear();
     }
 
+    /** The completions queued since last asked. Call with the lock held; dispatch with it released. */
+    auto take_completions() -> completion_batch {
+        return std::move(completions);
+    }
+
     void fire_birth_handlers(asio::error_code const &ec) {
         fire_wait_handlers(birth_signals, ec);
     }
@@ -197,8 +313,33 @@ struct goblin_state_ : msmf::state_machine_def<goblin_state_> {
         fire_wait_handlers(death_signals, ec);
     }
 
-    std::vector<birth_signal> birth_signals;
-    std::vector<death_signal> death_signals;
+    void state_entered(goblin_state_id state) {
+        goblin_metrics::state_entered(std::size_t(state));
+        mark_entered();
+    }
+
+    void state_left(goblin_state_id state) {
+        goblin_metrics::state_left(std::size_t(state), entered_at());
+    }
+
+    wait_signals birth_signals;
+    wait_signals death_signals;
+    completion_batch completions;
+
+    /** the id of the goblin which owns this state machine, for tracing */
+    std::uint64_t goblin_id = 0;
+
+    /** where kills are reported; none if null */
+    goblin_kill_hub *kills = nullptr;
 };
 
-using GoblinState = msmb::state_machine<goblin_state_>;
+/* The back-end which runs goblin_state_. Both read the same transition table; the table-driven one dispatches
+ * each event through a flat jump table rather than msm's generic machinery. */
+using MsmGoblinState = msmb::state_machine<goblin_state_>;
+using TableGoblinState = table_state_machine<goblin_state_>;
+
+#if defined(GOBLINS_TABLE_STATE_MACHINE)
+using GoblinState = TableGoblinState;
+#else
+using GoblinState = MsmGoblinState;
+#endif
@@ -2,19 +2,24 @@
 #include "goblin_impl.hpp"
 
 
-template<>
-auto goblin_state_::KillingFolk::on_entry(GoblinBorn const &event, GoblinState &fsm) -> void {
+template<class FSM>
+auto goblin_state_::KillingFolk::on_entry(GoblinBorn const &event, FSM &fsm) -> void {
+    fsm.state_entered(goblin_state_id::killing_folk);
     fsm.fire_birth_handlers(asio::error_code());
+    // the timer registers with the worker executor's timing wheel rather than the reactor's timer queue
     this->kill_timer_.emplace(event.impl.get_executor());
     auto &timer = kill_timer_.get();
-    timer.expires_from_now(boost::posix_time::seconds(5));
 
     // take a shared pointer to the impl, not the handle
     auto impl_ptr = event.impl.shared_from_this();
-    timer.async_wait([impl_ptr](asio::error_code const &ec) {
-        if (not ec) {
-            impl_ptr->process_event(GoblinKilledSomeone{*impl_ptr});
-        }
+    auto kill_after = std::chrono::seconds(5);
+    event.impl.set_kill_deadline(timer.now() + kill_after);
+    timer.async_wait_for(kill_after, [impl_ptr]() {
+        impl_ptr->process_event(GoblinKilledSomeone{*impl_ptr});
     });
 
 }
+
+// both back-ends, so that either can be used whichever is GoblinState
+template void goblin_state_::KillingFolk::on_entry(GoblinBorn const &, MsmGoblinState &);
+template void goblin_state_::KillingFolk::on_entry(GoblinBorn const &, TableGoblinState &);
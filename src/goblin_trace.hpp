@@ -0,0 +1,250 @@
+#pragma once
+
+#include "config.hpp"
+#include "goblin_trace_format.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+/** The trace_event recorded for an event type. Specialised next to the events themselves. */
+template<class Event>
+struct trace_event_of : std::integral_constant<trace_event, trace_event::unknown> {};
+
+namespace detail {
+
+    /** One record in a trace_ring, kept as a seqlock: the writer clears the sequence before it changes the
+     * fields, and stores the new sequence after, so a reader which finds the same sequence on both sides of
+     * its copy has copied one whole record. The fields are relaxed atomics, so that a copy which races with
+     * the writer is merely discarded rather than undefined.
+     */
+    struct trace_slot {
+        void write(std::uint64_t seq, std::uint64_t ticks, std::uint64_t gob, trace_event ev,
+                   std::uint8_t from_state, std::uint8_t to_state) {
+            sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            timestamp.store(ticks, std::memory_order_relaxed);
+            goblin.store(gob, std::memory_order_relaxed);
+            event.store(std::uint16_t(ev), std::memory_order_relaxed);
+            from.store(from_state, std::memory_order_relaxed);
+            to.store(to_state, std::memory_order_relaxed);
+            sequence.store(seq, std::memory_order_release);
+        }
+
+        /** The record in the slot, with sequence 0 if it was being written meanwhile */
+        auto read(std::uint32_t thread) const -> trace_record {
+            trace_record r{};
+            auto before = sequence.load(std::memory_order_acquire);
+            r.timestamp = timestamp.load(std::memory_order_relaxed);
+            r.goblin = goblin.load(std::memory_order_relaxed);
+            r.event = event.load(std::memory_order_relaxed);
+            r.from = from.load(std::memory_order_relaxed);
+            r.to = to.load(std::memory_order_relaxed);
+            r.thread = thread;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            r.sequence = sequence.load(std::memory_order_relaxed) == before ? before : 0;
+            return r;
+        }
+
+        std::atomic<std::uint64_t> sequence{0};
+        std::atomic<std::uint64_t> timestamp{0};
+        std::atomic<std::uint64_t> goblin{0};
+        std::atomic<std::uint16_t> event{0};
+        std::atomic<std::uint8_t> from{0};
+        std::atomic<std::uint8_t> to{0};
+    };
+
+    /** The records of one thread. Only that thread writes, so writing is a few relaxed stores and release
+     * stores of the slot's sequence and of the count; nothing is locked. Oldest records are overwritten once
+     * the ring is full.
+     */
+    struct trace_ring {
+        static constexpr std::size_t capacity = 8192;
+
+        explicit trace_ring(std::uint32_t thread) : thread(thread) {}
+
+        void record(std::uint64_t ticks, std::uint64_t goblin, trace_event event,
+                    std::uint8_t from, std::uint8_t to) {
+            auto sequence = written.load(std::memory_order_relaxed) + 1;
+            slots[(sequence - 1) % capacity].write(sequence, ticks, goblin, event, from, to);
+            written.store(sequence, std::memory_order_release);
+        }
+
+        std::uint32_t const thread;
+        std::atomic<std::uint64_t> written{0};
+        std::atomic<bool> in_use{false};
+        trace_slot slots[capacity];
+    };
+
+    /** Every trace_ring ever created, in the manner of metrics_registry: a thread claims a ring the first
+     * time it records and gives it back when it exits. Rings are never freed, so a dump still holds the last
+     * records of threads which have gone.
+     */
+    struct trace_registry {
+        static auto instance() -> trace_registry & {
+            // leaked, so that threads may trace during static destruction
+            static trace_registry *registry = new trace_registry();
+            return *registry;
+        }
+
+        auto claim() -> trace_ring * {
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            for (auto &ring : rings_) {
+                if (not ring->in_use.exchange(true)) return ring.get();
+            }
+            rings_.push_back(std::make_unique<trace_ring>(std::uint32_t(rings_.size())));
+            rings_.back()->in_use.store(true);
+            return rings_.back().get();
+        }
+
+        void give_back(trace_ring *ring) {
+            ring->in_use.store(false);
+        }
+
+        void dump(std::string const &path, asio::error_code &ec) {
+            // rings are never freed, so the file can be written without holding up threads claiming rings
+            std::vector<trace_ring const *> rings;
+            {
+                auto lock = std::unique_lock<std::mutex>(mutex_);
+                rings.reserve(rings_.size());
+                for (auto &ring : rings_) rings.push_back(ring.get());
+            }
+
+            trace_file_header header{};
+            std::memcpy(header.magic, trace_file_header::expected_magic(), sizeof(header.magic));
+            header.version = trace_file_header::current_version;
+            header.ring_count = std::uint32_t(rings.size());
+            header.ring_capacity = std::uint32_t(trace_ring::capacity);
+            header.start_ticks = start_ticks_;
+            header.start_nanoseconds = start_nanoseconds_;
+            header.dump_ticks = ticks();
+            header.dump_nanoseconds = nanoseconds();
+
+            auto ring_size = sizeof(trace_ring_header) + sizeof(trace_record) * trace_ring::capacity;
+            auto size = sizeof(header) + ring_size * rings.size();
+            write_file(path, size, [&](char *out) {
+                std::memcpy(out, &header, sizeof(header));
+                out += sizeof(header);
+                for (auto ring : rings) {
+                    trace_ring_header ring_header{};
+                    ring_header.thread = ring->thread;
+                    ring_header.written = ring->written.load(std::memory_order_acquire);
+                    std::memcpy(out, &ring_header, sizeof(ring_header));
+                    auto record_out = out + sizeof(ring_header);
+                    for (auto const &slot : ring->slots) {
+                        auto record = slot.read(ring->thread);
+                        std::memcpy(record_out, &record, sizeof(record));
+                        record_out += sizeof(record);
+                    }
+                    out += ring_size;
+                }
+            }, ec);
+        }
+
+        /** The tick clock: the cpu's time stamp counter where there is one, otherwise steady_clock */
+        static auto ticks() -> std::uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return nanoseconds();
+#endif
+        }
+
+    private:
+        trace_registry() = default;
+
+        static auto nanoseconds() -> std::uint64_t {
+            auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+            return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count());
+        }
+
+        template<class Fill>
+        static void write_file(std::string const &path, std::size_t size, Fill fill, asio::error_code &ec) {
+            ec.clear();
+#if defined(__unix__) || defined(__APPLE__)
+            auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                ec.assign(errno, asio::error::get_system_category());
+                return;
+            }
+            void *mapped = MAP_FAILED;
+            if (::ftruncate(fd, off_t(size)) == 0) {
+                mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            if (mapped == MAP_FAILED) {
+                ec.assign(errno, asio::error::get_system_category());
+            } else {
+                fill(static_cast<char *>(mapped));
+                ::munmap(mapped, size);
+            }
+            ::close(fd);
+#else
+            std::vector<char> buffer(size);
+            fill(buffer.data());
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (not file.write(buffer.data(), std::streamsize(size))) {
+                ec = asio::error::fault;
+            }
+#endif
+        }
+
+        std::mutex mutex_;
+        std::vector<std::unique_ptr<trace_ring>> rings_;
+        std::uint64_t const start_ticks_ = ticks();
+        std::uint64_t const start_nanoseconds_ = nanoseconds();
+    };
+
+    inline auto this_thread_trace() -> trace_ring & {
+        struct owner {
+            owner() : ring(trace_registry::instance().claim()) {}
+
+            ~owner() { trace_registry::instance().give_back(ring); }
+
+            trace_ring *ring;
+        };
+        static thread_local owner mine;
+        return *mine.ring;
+    }
+}
+
+/** An always-on, in-memory trace of every event processed by every goblin.
+ *
+ * Each thread records into its own ring of the most recent trace_ring::capacity records. dump() writes every
+ * ring to a file, which the goblin-trace-decode tool turns into a timeline.
+ */
+struct goblin_trace {
+    /** Record one event. from and to are goblin_state_id values. */
+    static void record(std::uint64_t goblin, trace_event event, std::uint8_t from, std::uint8_t to) {
+        detail::this_thread_trace().record(detail::trace_registry::ticks(), goblin, event, from, to);
+    }
+
+    /** Write every thread's ring to the file at path, replacing it. Tracing carries on meanwhile. */
+    static void dump(std::string const &path, asio::error_code &ec) {
+        detail::trace_registry::instance().dump(path, ec);
+    }
+
+    static void dump(std::string const &path) {
+        asio::error_code ec;
+        dump(path, ec);
+        if (ec) throw boost::system::system_error(ec, "goblin_trace::dump");
+    }
+};
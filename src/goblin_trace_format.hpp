@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+/* The layout of a goblin trace dump. Shared by goblin_trace, which writes it, and the goblin-trace-decode tool,
+ * which reads it, so it depends on nothing else.
+ *
+ * A dump is a trace_file_header followed by ring_count rings. Each ring is a trace_ring_header followed by
+ * ring_capacity trace_records, in slot order. All fields are in the byte order of the machine which wrote them.
+ */
+
+/** What happened to the goblin */
+enum class trace_event : std::uint16_t {
+    unknown,
+    born,
+    killed_someone,
+    dies,
+    add_birth_handler,
+    add_death_handler,
+    no_transition,
+    exception,
+};
+
+inline auto trace_event_name(std::uint16_t event) -> char const * {
+    static char const *const names[] = {
+            "unknown", "GoblinBorn", "GoblinKilledSomeone", "GoblinDies",
+            "EventAddBirthHandler", "EventAddDeathHandler", "no_transition", "exception",
+    };
+    return event < sizeof(names) / sizeof(names[0]) ? names[event] : "?";
+}
+
+/** Names for the values of goblin_state_id */
+inline auto trace_state_name(std::uint8_t state) -> char const * {
+    static char const *const names[] = {"Unborn", "KillingFolk", "Dead"};
+    return state < sizeof(names) / sizeof(names[0]) ? names[state] : "?";
+}
+
+struct trace_record {
+    /** 1 for the first record a ring ever held, and so on. 0 if the slot has never been written, or was being
+     * written when the dump was taken. */
+    std::uint64_t sequence;
+    /** ticks of the clock described in trace_file_header */
+    std::uint64_t timestamp;
+    std::uint64_t goblin;
+    std::uint16_t event;
+    std::uint8_t from;
+    std::uint8_t to;
+    std::uint32_t thread;
+};
+
+static_assert(sizeof(trace_record) == 32, "trace records are written to disk");
+
+struct trace_file_header {
+    /** the first 8 characters, without the terminating null, are the file's magic */
+    static auto expected_magic() -> char const * { return "GOBTRACE"; }
+    static constexpr std::uint32_t current_version = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t ring_count;
+    std::uint32_t ring_capacity;
+    std::uint32_t reserved;
+
+    /* Two readings of the tick clock and of steady_clock in nanoseconds, taken when tracing started and when the
+     * dump was written. Ticks are converted to nanoseconds by interpolating between them. */
+    std::uint64_t start_ticks;
+    std::uint64_t start_nanoseconds;
+    std::uint64_t dump_ticks;
+    std::uint64_t dump_nanoseconds;
+};
+
+struct trace_ring_header {
+    std::uint32_t thread;
+    std::uint32_t reserved;
+    /** the number of records ever written to the ring. The most recent is in slot (written - 1) % capacity. */
+    std::uint64_t written;
+};
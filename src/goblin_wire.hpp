@@ -0,0 +1,477 @@
+#pragma once
+
+#include "config.hpp"
+#include "completion_batch.hpp"
+#include "goblin_error.hpp"
+#include "goblin_shm_ring.hpp"
+
+#include <boost/utility/string_view.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace detail {
+
+    /** What a frame asks for, or reports. The goblin of every frame but complete is the key the link gave it. */
+    enum class wire_op : std::uint8_t {
+        /* link to host */
+        construct = 1,      // the payload is the goblin's name
+        destroy,
+        be_born,
+        die,
+        spawn,              // tag identifies the waiter, which is answered by complete
+        on_birth,
+        wait_death,
+        /* host to link */
+        complete,           // tag, with the error in category and value
+        state,              // tag is the goblin's packed goblin_snapshot
+        /* either way, handled by wire_connection */
+        map,                // the payload names a shm_segment, through which every later frame travels
+    };
+
+    /** One frame of the goblin protocol: a 24-byte little-endian header followed by payload_size bytes.
+     * Frames are fixed-size but for the payload, so many of them can be written and parsed in one buffer.
+     */
+    struct wire_frame {
+        static constexpr std::size_t header_size = 24;
+
+        /* The error categories a frame can carry. Others cannot be named in another process, so they travel as
+         * goblin_error::foreign_error. */
+        static constexpr std::uint8_t no_error = 0;
+        static constexpr std::uint8_t goblin_errors = 1;
+        static constexpr std::uint8_t system_errors = 2;
+        static constexpr std::uint8_t generic_errors = 3;
+        static constexpr std::uint8_t misc_errors = 4;
+
+        wire_op op = wire_op::complete;
+        std::uint8_t category = no_error;
+        std::uint16_t payload_size = 0;
+        std::int32_t value = 0;
+        std::uint64_t goblin = 0;
+        std::uint64_t tag = 0;
+
+        void set_error(asio::error_code const &ec) {
+            value = ec.value();
+            if (not ec) category = no_error;
+            else if (ec.category() == goblin_category()) category = goblin_errors;
+            else if (ec.category() == boost::system::system_category()) category = system_errors;
+            else if (ec.category() == boost::system::generic_category()) category = generic_errors;
+            else if (ec.category() == asio::error::get_misc_category()) category = misc_errors;
+            else {
+                category = goblin_errors;
+                value = int(goblin_error::foreign_error);
+            }
+        }
+
+        auto error() const -> asio::error_code {
+            switch (category) {
+                case goblin_errors:
+                    return asio::error_code(value, goblin_category());
+                case system_errors:
+                    return asio::error_code(value, boost::system::system_category());
+                case generic_errors:
+                    return asio::error_code(value, boost::system::generic_category());
+                case misc_errors:
+                    return asio::error_code(value, asio::error::get_misc_category());
+                default:
+                    return {};
+            }
+        }
+
+        /** Append the frame and its payload to out */
+        void encode(std::string &out, boost::string_view payload = {}) const {
+            char header[header_size];
+            encode_header(header, payload.size());
+            out.append(header, header_size);
+            out.append(payload.data(), payload.size());
+        }
+
+        /** Write the header, for a payload of payload_size bytes, to header_size bytes at out */
+        void encode_header(char *out, std::size_t payload_size) const {
+            out[0] = char(op);
+            out[1] = char(category);
+            put(out + 2, payload_size, 2);
+            put(out + 4, std::uint32_t(value), 4);
+            put(out + 8, goblin, 8);
+            put(out + 16, tag, 8);
+        }
+
+        /** Read a frame's header from data, which holds at least header_size bytes.
+         * @return the size of the whole frame, or 0 if it carries an error which this end does not know
+         */
+        auto decode(char const *data) -> std::size_t {
+            op = wire_op(std::uint8_t(data[0]));
+            category = std::uint8_t(data[1]);
+            payload_size = std::uint16_t(get(data + 2, 2));
+            value = std::int32_t(std::uint32_t(get(data + 4, 4)));
+            goblin = get(data + 8, 8);
+            tag = get(data + 16, 8);
+            if (not error_is_known()) return 0;
+            return header_size + payload_size;
+        }
+
+    private:
+        bool error_is_known() const {
+            switch (category) {
+                case no_error:
+                    return value == 0;
+                case goblin_errors:
+                    return value >= int(goblin_error::actually_dead) and value <= int(goblin_error::foreign_error);
+                case system_errors:
+                case generic_errors:
+                    return value > 0;
+                case misc_errors:
+                    return value >= asio::error::already_open and value <= asio::error::fd_set_failure;
+                default:
+                    return false;
+            }
+        }
+
+        static void put(char *out, std::uint64_t x, std::size_t bytes) {
+            for (std::size_t i = 0; i < bytes; ++i) out[i] = char((x >> (8 * i)) & 0xff);
+        }
+
+        static auto get(char const *in, std::size_t bytes) -> std::uint64_t {
+            std::uint64_t x = 0;
+            for (std::size_t i = 0; i < bytes; ++i) x |= std::uint64_t(std::uint8_t(in[i])) << (8 * i);
+            return x;
+        }
+    };
+
+    /** The threads which read the shared-memory rings of an io_service's wire_connections.
+     *
+     * Each thread holds its connection, whose socket belongs to the io_service, so when the io_service shuts down
+     * every thread is told to stop, by closing its segment, and joined; none of them, nor the last reference to
+     * a connection, outlives it. Threads which have finished are joined as new ones start.
+     */
+    struct wire_consumer_service : asio::detail::service_base<wire_consumer_service> {
+        explicit wire_consumer_service(asio::io_service &owner)
+                : asio::detail::service_base<wire_consumer_service>(owner) {}
+
+        /** Call consume() on a new thread. It must return once segment is closed. */
+        template<class Consume>
+        void start(std::shared_ptr<shm_segment> segment, Consume consume) {
+            auto lock = lock_type(mutex_);
+            if (shut_down_) {
+                segment->close();
+                return;
+            }
+            reap();
+            consumers_.emplace_back();
+            auto &consumer = consumers_.back();
+            consumer.segment = std::move(segment);
+            consumer.thread = std::thread([&finished = consumer.finished, consume = std::move(consume)]() mutable {
+                consume();
+                finished.store(true);
+            });
+        }
+
+    private:
+        using lock_type = std::unique_lock<std::mutex>;
+
+        struct consumer {
+            std::shared_ptr<shm_segment> segment;
+            std::thread thread;
+            std::atomic<bool> finished{false};
+        };
+
+        void shutdown_service() override {
+            auto lock = lock_type(mutex_);
+            shut_down_ = true;
+            auto consumers = std::move(consumers_);
+            consumers_.clear();
+            lock.unlock();
+            for (auto &c : consumers) c.segment->close();
+            for (auto &c : consumers) c.thread.join();
+        }
+
+        void reap() {
+            for (auto it = consumers_.begin(); it != consumers_.end();) {
+                if (it->finished.load()) {
+                    it->thread.join();
+                    it = consumers_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        std::mutex mutex_;
+        std::list<consumer> consumers_;
+        bool shut_down_ = false;
+    };
+
+    /** A Unix domain socket carrying frames, for the two ends of a goblin_link.
+     *
+     * send() may be called from any thread. Frames are appended to an output buffer, and whatever has built up
+     * while one write is in flight goes out in the next, so a burst of events costs one syscall rather than one
+     * per event. Each read is parsed into as many frames as it holds, and Derived::handle_frame is called for
+     * each with one completion_batch, dispatched once the read has been parsed. All socket operations run on one
+     * strand.
+     *
+     * Once the link side calls request_shared_memory, frames travel through a shm_segment instead: send() copies
+     * each one straight into the outbound ring, and a thread of the connection's own reads the inbound ring,
+     * handling frames where they lie and sleeping on a futex only when it runs dry; the io_service's
+     * wire_consumer_service joins it. Senders take the output mutex, so each ring has one producer at a time. A
+     * frame which finds the ring full joins a backlog, which that thread drains once the peer has made room, so
+     * a sender never waits for the peer. The socket stays open, to set the segment up and to tell each side
+     * when the other has gone.
+     *
+     * When the socket fails or is closed, Derived::handle_close is called once, and frames sent after that are
+     * dropped.
+     */
+    template<class Derived>
+    class wire_connection : public std::enable_shared_from_this<Derived> {
+    public:
+        using protocol_type = asio::local::stream_protocol;
+        using socket_type = protocol_type::socket;
+
+        auto socket() -> socket_type & { return socket_; }
+
+        /** Start reading frames */
+        void start() {
+            auto self = this->shared_from_this();
+            strand_.dispatch([self] { self->read(); });
+        }
+
+        void send(wire_frame const &frame, boost::string_view payload = {}) {
+            auto lock = lock_type(output_mutex_);
+            if (closed_) return;
+            if (segment_) {
+                if (backlog_.empty()) {
+                    char header[wire_frame::header_size];
+                    frame.encode_header(header, payload.size());
+                    if (segment_->outbound(side_).try_write(header, wire_frame::header_size, payload)) return;
+                }
+                frame.encode(backlog_, payload);
+                drain_backlog();
+                return;
+            }
+            frame.encode(output_, payload);
+            if (writing_) return;
+            writing_ = true;
+            lock.unlock();
+            auto self = this->shared_from_this();
+            strand_.post([self] { self->write(); });
+        }
+
+        /** Close the socket. handle_close is called once the read in progress has failed. */
+        void close() {
+            auto self = this->shared_from_this();
+            strand_.dispatch([self] {
+                asio::error_code ignored;
+                self->socket_.close(ignored);
+            });
+        }
+
+        bool is_open() const {
+            auto lock = lock_type(output_mutex_);
+            return not closed_;
+        }
+
+        /** Carry every later frame, both ways, through a new shared-memory segment.
+         * Must be called on the connected socket before start(). Blocks until the peer has been told, and throws
+         * boost::system::system_error if the segment cannot be made or the peer cannot be told.
+         */
+        void request_shared_memory() {
+            auto segment = shm_segment::create();
+            wire_frame frame;
+            frame.op = wire_op::map;
+            std::string request;
+            frame.encode(request, segment->name());
+            asio::write(socket_, asio::buffer(request));
+            map(std::move(segment), 0);
+        }
+
+    protected:
+        explicit wire_connection(asio::io_service &owner) : owner_(owner), socket_(owner), strand_(owner) {}
+
+    private:
+        using lock_type = std::unique_lock<std::mutex>;
+
+        auto derived() -> Derived & { return static_cast<Derived &>(*this); }
+
+        void write() {
+            auto lock = lock_type(output_mutex_);
+            writing_buffer_.clear();
+            writing_buffer_.swap(output_);
+            lock.unlock();
+            auto self = this->shared_from_this();
+            asio::async_write(socket_, asio::buffer(writing_buffer_),
+                              strand_.wrap([self](asio::error_code const &ec, std::size_t) {
+                                  if (ec) return self->fail();
+                                  auto lock = lock_type(self->output_mutex_);
+                                  if (self->output_.empty()) {
+                                      self->writing_ = false;
+                                      return;
+                                  }
+                                  lock.unlock();
+                                  self->write();
+                              }));
+        }
+
+        void read() {
+            auto self = this->shared_from_this();
+            socket_.async_read_some(asio::buffer(read_buffer_),
+                                    strand_.wrap([self](asio::error_code const &ec, std::size_t size) {
+                                        if (ec) return self->fail();
+                                        self->input_.append(self->read_buffer_.data(), size);
+                                        if (not self->parse()) return self->fail();
+                                        self->read();
+                                    }));
+        }
+
+        /** Handle every whole frame in the input. False if the peer has broken the protocol. */
+        bool parse() {
+            completion_batch completions;
+            std::size_t used = 0;
+            bool ok = true;
+            while (ok and input_.size() - used >= wire_frame::header_size) {
+                wire_frame frame;
+                auto size = frame.decode(input_.data() + used);
+                if (size == 0) {
+                    ok = false;
+                    break;
+                }
+                if (input_.size() - used < size) break;
+                auto payload = boost::string_view(input_.data() + used + wire_frame::header_size, frame.payload_size);
+                ok = frame.op == wire_op::map ? accept_shared_memory(payload)
+                                              : derived().handle_frame(frame, payload, completions);
+                used += size;
+            }
+            input_.erase(0, used);
+            completions.dispatch();
+            return ok;
+        }
+
+        bool accept_shared_memory(boost::string_view name) {
+            try {
+                map(shm_segment::open(name.to_string()), 1);
+                return true;
+            }
+            catch (boost::system::system_error const &) {
+                return false;
+            }
+        }
+
+        void map(std::shared_ptr<shm_segment> segment, int side) {
+            auto lock = lock_type(output_mutex_);
+            segment_ = std::move(segment);
+            side_ = side;
+            mapped_.store(segment_.get());
+            auto self = this->shared_from_this();
+            asio::use_service<wire_consumer_service>(owner_).start(segment_, [self] { self->consume(); });
+        }
+
+        /** Move frames from the backlog into the outbound ring while they fit. Call with the output mutex held. */
+        void drain_backlog() {
+            auto &ring = segment_->outbound(side_);
+            std::size_t used = 0;
+            std::size_t front = 0;
+            while (used < backlog_.size()) {
+                wire_frame frame;
+                front = frame.decode(backlog_.data() + used);
+                if (ring.try_write(backlog_.data() + used, front, {})) {
+                    used += front;
+                    front = 0;
+                    continue;
+                }
+                ring.space_wanted.store(1, std::memory_order_seq_cst);
+                // the peer may have made room before it could see space_wanted, in which case it will not say so
+                if (not ring.has_room(front)) break;
+            }
+            backlog_.erase(0, used);
+            backlog_front_.store(front, std::memory_order_relaxed);
+        }
+
+        /** Whether the backlog has a frame which now fits in the outbound ring */
+        bool backlog_ready() const {
+            auto front = backlog_front_.load(std::memory_order_relaxed);
+            return front and segment_->outbound(side_).has_room(front);
+        }
+
+        /** Handle frames from the inbound ring, and drain the backlog, until the connection closes */
+        void consume() {
+            auto &segment = *segment_;
+            auto &ring = segment.inbound(side_);
+            auto &closed = segment.closed();
+            std::string scratch;
+            auto head = ring.head.load(std::memory_order_relaxed);
+            while (not closed.load(std::memory_order_acquire)) {
+                if (backlog_ready()) {
+                    auto lock = lock_type(output_mutex_);
+                    drain_backlog();
+                }
+                auto tail = ring.tail.load(std::memory_order_acquire);
+                if (head == tail) {
+                    ring.wait(head, [&] { return closed.load() or backlog_ready(); });
+                    continue;
+                }
+                completion_batch completions;
+                // the writer publishes whole frames within the ring, so anything else is corrupt
+                bool ok = tail - head <= shm_ring::capacity;
+                while (ok and head != tail) {
+                    if (tail - head < wire_frame::header_size) {
+                        ok = false;
+                        break;
+                    }
+                    char header[wire_frame::header_size];
+                    ring.copy_out(head, header, wire_frame::header_size);
+                    wire_frame frame;
+                    auto size = frame.decode(header);
+                    if (size == 0 or size > tail - head) {
+                        ok = false;
+                        break;
+                    }
+                    auto payload = ring.view(head + wire_frame::header_size, frame.payload_size, scratch);
+                    ok = derived().handle_frame(frame, payload, completions);
+                    head += size;
+                }
+                ring.release(head, segment.outbound(side_));
+                completions.dispatch();
+                if (not ok) return close();
+            }
+        }
+
+        void fail() {
+            if (auto segment = mapped_.load()) segment->close();
+            auto lock = lock_type(output_mutex_);
+            if (closed_) return;
+            closed_ = true;
+            output_.clear();
+            backlog_.clear();
+            backlog_front_.store(0, std::memory_order_relaxed);
+            lock.unlock();
+
+            asio::error_code ignored;
+            socket_.close(ignored);
+            completion_batch completions;
+            derived().handle_close(completions);
+            completions.dispatch();
+        }
+
+        asio::io_service &owner_;
+        socket_type socket_;
+        asio::io_service::strand strand_;
+        mutable std::mutex output_mutex_;
+        bool closed_ = false;
+        bool writing_ = false;
+        std::string output_;
+        // frames waiting for room in the outbound ring, and the size of the first of them
+        std::string backlog_;
+        std::atomic<std::size_t> backlog_front_{0};
+        std::shared_ptr<shm_segment> segment_;
+        std::atomic<shm_segment *> mapped_{nullptr};
+        int side_ = 0;
+        // only touched on the strand
+        std::string writing_buffer_;
+        std::string input_;
+        std::array<char, 65536> read_buffer_;
+    };
+}
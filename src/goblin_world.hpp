@@ -0,0 +1,256 @@
+#pragma once
+
+#include "chunk_directory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/** A structure-of-arrays copy of the state of every goblin of a goblin_service, for bulk queries.
+ *
+ * Each goblin owns one slot. Its state id, flags, kill count, kill deadline and id are kept in separate
+ * contiguous arrays, so that a query over millions of goblins is a linear scan of a few bytes per goblin, 16
+ * goblins at a time with SSE2, instead of a pointer chase and a lock per goblin.
+ *
+ * Goblins write their own slot after each transition, as they publish their state word. Queries run
+ * concurrently with those writes and take no lock: each element is read whole, but a query sees each goblin as
+ * it was at some moment during the scan, not all of them at the same moment.
+ *
+ * Slots live in fixed-size chunks, in a chunk_directory, which are never moved or freed while the world exists,
+ * so growing the world never disturbs a running scan.
+ *
+ * Kill deadlines are kept as 32 bit milliseconds since the world was created, which run out after about 49.7
+ * days. Later deadlines all read as that last millisecond, so for_each_due() no longer tells them apart.
+ */
+class goblin_world {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    static constexpr std::size_t chunk_size = 4096;
+    static constexpr std::size_t max_chunks = 65536;
+    static constexpr std::uint32_t no_slot = ~std::uint32_t(0);
+
+    /* bits of the flags array */
+    static constexpr std::uint8_t occupied = 1;
+    static constexpr std::uint8_t running = 2;
+    static constexpr std::uint8_t dead = 4;
+
+    goblin_world() = default;
+
+    goblin_world(goblin_world const &) = delete;
+
+    goblin_world &operator=(goblin_world const &) = delete;
+
+    /** Claim a slot for the goblin with the given id. The slot starts out unborn and not running. */
+    auto allocate(std::uint64_t goblin_id) -> std::uint32_t {
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        std::uint32_t slot;
+        if (not free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            slot = std::uint32_t(size_.load(std::memory_order_relaxed));
+            if (slot / chunk_size >= max_chunks) throw std::length_error("goblin_world is full");
+            if (slot % chunk_size == 0) {
+                chunks_.add(slot / chunk_size);
+            }
+            size_.store(slot + 1, std::memory_order_release);
+        }
+        auto &c = chunk_of(slot);
+        auto i = slot % chunk_size;
+        store(c.ids[i], goblin_id);
+        store(c.kills[i], std::uint32_t(0));
+        store(c.deadlines[i], std::uint32_t(0));
+        store(c.states[i], std::uint8_t(0));
+        store(c.flags[i], occupied);
+        return slot;
+    }
+
+    void release(std::uint32_t slot) {
+        auto &c = chunk_of(slot);
+        store(c.flags[slot % chunk_size], std::uint8_t(0));
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        free_slots_.push_back(slot);
+    }
+
+    /** Record a goblin's state. Called by the goblin after every transition. */
+    void set_state(std::uint32_t slot, std::uint8_t state, bool is_running, bool is_dead) {
+        auto &c = chunk_of(slot);
+        auto i = slot % chunk_size;
+        store(c.states[i], state);
+        store(c.flags[i], std::uint8_t(occupied | (is_running ? running : 0) | (is_dead ? dead : 0)));
+    }
+
+    void add_kill(std::uint32_t slot) {
+        auto &c = chunk_of(slot);
+        auto i = slot % chunk_size;
+        store(c.kills[i], load(c.kills[i]) + 1);
+    }
+
+    /** Record when the goblin will next kill, or clear it */
+    void set_deadline(std::uint32_t slot, clock_type::time_point when) {
+        store(chunk_of(slot).deadlines[slot % chunk_size], to_ticks(when));
+    }
+
+    void clear_deadline(std::uint32_t slot) {
+        store(chunk_of(slot).deadlines[slot % chunk_size], std::uint32_t(0));
+    }
+
+    auto kills(std::uint32_t slot) const -> std::uint32_t {
+        return load(chunk_of(slot).kills[slot % chunk_size]);
+    }
+
+    /** The number of goblins which are running and not dead */
+    auto count_alive() const -> std::size_t {
+        return count_flags(occupied | running | dead, occupied | running);
+    }
+
+    /** The number of goblins for which is_dead() is true: occupied, but not alive. Counted in one pass, since
+     * goblins are born and die while it runs. */
+    auto count_dead() const -> std::size_t {
+        return count_flags(occupied, occupied, occupied | running | dead, occupied | running);
+    }
+
+    auto count() const -> std::size_t {
+        return count_flags(occupied, occupied);
+    }
+
+    /** True if no goblin is alive. Stops at the first chunk with a live goblin. */
+    bool all_dead() const {
+        auto chunks = chunk_count();
+        for (std::size_t n = 0; n < chunks; ++n) {
+            if (count_flags_in(n, occupied | running | dead, occupied | running)) return false;
+        }
+        return true;
+    }
+
+    /** Call f(slot, goblin_id) for each goblin with a kill deadline at or before when */
+    template<class F>
+    void for_each_due(clock_type::time_point when, F &&f) const {
+        auto limit = to_ticks(when);
+        auto chunks = chunk_count();
+        for (std::size_t n = 0; n < chunks; ++n) {
+            auto &c = chunks_[n];
+            auto used = used_in(n);
+            std::size_t i = 0;
+#if defined(__SSE2__)
+            // deadlines are unsigned; flip the sign bits so that the signed comparison orders them correctly
+            auto bias = _mm_set1_epi32(std::int32_t(0x80000000u));
+            auto biased_limit = _mm_xor_si128(_mm_set1_epi32(std::int32_t(limit)), bias);
+            auto zero = _mm_setzero_si128();
+            for (; i + 4 <= used; i += 4) {
+                auto d = _mm_load_si128(reinterpret_cast<__m128i const *>(c.deadlines + i));
+                auto late = _mm_cmpgt_epi32(_mm_xor_si128(d, bias), biased_limit);
+                auto none = _mm_cmpeq_epi32(d, zero);
+                auto mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(late, none))) & 0xf;
+                while (mask) {
+                    auto bit = __builtin_ctz(unsigned(mask));
+                    mask &= mask - 1;
+                    report_due(c, n, i + bit, limit, f);
+                }
+            }
+#endif
+            for (; i < used; ++i) {
+                report_due(c, n, i, limit, f);
+            }
+        }
+    }
+
+    /** The number of slots ever allocated, including free ones */
+    auto capacity() const -> std::size_t { return size_.load(std::memory_order_acquire); }
+
+private:
+    struct chunk {
+        alignas(16) std::uint8_t states[chunk_size] = {};
+        alignas(16) std::uint8_t flags[chunk_size] = {};
+        alignas(16) std::uint32_t deadlines[chunk_size] = {};
+        alignas(16) std::uint32_t kills[chunk_size] = {};
+        std::uint64_t ids[chunk_size] = {};
+    };
+
+    template<class T>
+    static void store(T &target, T value) { __atomic_store_n(&target, value, __ATOMIC_RELAXED); }
+
+    template<class T>
+    static auto load(T const &source) -> T { return __atomic_load_n(&source, __ATOMIC_RELAXED); }
+
+    auto chunk_of(std::uint32_t slot) const -> chunk & {
+        return chunks_[slot / chunk_size];
+    }
+
+    auto chunk_count() const -> std::size_t {
+        return (capacity() + chunk_size - 1) / chunk_size;
+    }
+
+    auto used_in(std::size_t n) const -> std::size_t {
+        auto remaining = capacity() - n * chunk_size;
+        return remaining < chunk_size ? remaining : chunk_size;
+    }
+
+    /** Milliseconds since the world was created, plus one, so that zero can mean no deadline. Saturates rather
+     * than wrapping, so that a deadline past the range is never taken for an early one. */
+    auto to_ticks(clock_type::time_point when) const -> std::uint32_t {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(when - epoch_).count();
+        auto last = decltype(ms)(~std::uint32_t(0)) - 1;
+        return std::uint32_t(std::min(std::max<decltype(ms)>(ms, 0), last) + 1);
+    }
+
+    template<class F>
+    void report_due(chunk const &c, std::size_t n, std::size_t i, std::uint32_t limit, F &f) const {
+        auto deadline = load(c.deadlines[i]);
+        if (deadline == 0 or deadline > limit or not(load(c.flags[i]) & occupied)) return;
+        f(std::uint32_t(n * chunk_size + i), load(c.ids[i]));
+    }
+
+    auto count_flags(std::uint8_t mask, std::uint8_t wanted,
+                     std::uint8_t except_mask = 0, std::uint8_t except = 0xff) const -> std::size_t {
+        std::size_t result = 0;
+        auto chunks = chunk_count();
+        for (std::size_t n = 0; n < chunks; ++n) {
+            result += count_flags_in(n, mask, wanted, except_mask, except);
+        }
+        return result;
+    }
+
+    /** The number of slots in chunk n whose flags, masked, equal wanted, and masked by except_mask do not
+     * equal except. The default exception matches nothing. */
+    auto count_flags_in(std::size_t n, std::uint8_t mask, std::uint8_t wanted,
+                        std::uint8_t except_mask = 0, std::uint8_t except = 0xff) const -> std::size_t {
+        auto &c = chunks_[n];
+        auto used = used_in(n);
+        std::size_t result = 0;
+        std::size_t i = 0;
+#if defined(__SSE2__)
+        auto m = _mm_set1_epi8(char(mask));
+        auto w = _mm_set1_epi8(char(wanted));
+        auto xm = _mm_set1_epi8(char(except_mask));
+        auto x = _mm_set1_epi8(char(except));
+        for (; i + 16 <= used; i += 16) {
+            auto f = _mm_load_si128(reinterpret_cast<__m128i const *>(c.flags + i));
+            auto hits = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(f, xm), x),
+                                         _mm_cmpeq_epi8(_mm_and_si128(f, m), w));
+            result += std::size_t(__builtin_popcount(unsigned(_mm_movemask_epi8(hits))));
+        }
+#endif
+        for (; i < used; ++i) {
+            auto f = load(c.flags[i]);
+            result += (f & mask) == wanted and (f & except_mask) != except;
+        }
+        return result;
+    }
+
+    std::mutex mutex_;
+    std::vector<std::uint32_t> free_slots_;
+    std::atomic<std::size_t> size_{0};
+    chunk_directory<chunk, max_chunks> chunks_;
+    clock_type::time_point const epoch_ = clock_type::now();
+};
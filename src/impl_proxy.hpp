@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+
+template<class Implementation>
+struct impl_proxy {
+    impl_proxy(std::shared_ptr<Implementation> impl)
+            : impl_(impl) {
+    }
+
+    impl_proxy(const impl_proxy &) = delete;
+
+    impl_proxy &operator=(const impl_proxy &) = delete;
+
+    ~impl_proxy() {
+        if (started_) {
+            impl_->stop();
+        }
+    }
+
+    void start() {
+        impl_->start();
+        started_ = true;
+    }
+
+    auto get_impl_ptr() -> Implementation * {
+        return impl_.get();
+    }
+
+    std::shared_ptr<Implementation> impl_;
+    bool started_ = false;
+};
@@ -21,7 +21,16 @@ struct run_pool {
     }
 
     void add_thread() {
-        threads_.emplace_back([&, work = asio::io_service::work(executor_)] { this->run(); });
+        add_thread([] {});
+    }
+
+    /** Add a thread which calls init() before it starts running the executor */
+    template<class Init>
+    void add_thread(Init init) {
+        threads_.emplace_back([&, init, work = asio::io_service::work(executor_)] {
+            init();
+            this->run();
+        });
     }
 
     void stop() {
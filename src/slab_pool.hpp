@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/** A process-wide pool of fixed size blocks, carved from large slabs.
+ *
+ * Requests are rounded up to a multiple of the granularity. Each thread keeps a free list per size class, so
+ * allocating and freeing on a thread that already has cached blocks takes no lock and never touches the
+ * global allocator. Threads exchange blocks with a shared depot in batches when their lists run dry or grow too
+ * long, and return everything to the depot when they exit. Slabs are never returned to the system.
+ *
+ * Requests larger than max_block_size go straight to the global allocator.
+ */
+struct slab_pool {
+    static constexpr std::size_t granularity = 64;
+    static constexpr std::size_t max_block_size = 2048;
+    static constexpr std::size_t size_class_count = max_block_size / granularity;
+    static constexpr std::size_t slab_bytes = 64 * 1024;
+    static constexpr std::size_t transfer_batch = 128;
+    static constexpr std::size_t max_cached_per_thread = 4 * transfer_batch;
+
+    struct statistics {
+        std::size_t slabs_allocated;
+        std::size_t large_allocations;
+    };
+
+    static void *allocate(std::size_t bytes) {
+        if (bytes > max_block_size) {
+            get_depot().large_allocations.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(bytes);
+        }
+        auto cls = size_class(bytes);
+        auto &cache = this_thread_cache();
+        auto &list = cache.lists[cls];
+        if (not list.head) {
+            refill(cache, cls);
+        }
+        auto block = list.head;
+        list.head = block->next;
+        --list.count;
+        return block;
+    }
+
+    static void deallocate(void *p, std::size_t bytes) noexcept {
+        if (not p) return;
+        if (bytes > max_block_size) {
+            ::operator delete(p);
+            return;
+        }
+        auto cls = size_class(bytes);
+        auto block = static_cast<free_block *>(p);
+        auto &cache = this_thread_cache();
+        if (cache.flushed) {
+            // this thread is exiting, hand the block straight back to the depot
+            auto &depot = get_depot();
+            auto lock = lock_type(depot.mutex);
+            depot.lists[cls].push(block);
+            return;
+        }
+        auto &list = cache.lists[cls];
+        list.push(block);
+        if (list.count > max_cached_per_thread) {
+            drain(list, cls, transfer_batch);
+        }
+    }
+
+    static auto stats() -> statistics {
+        auto &depot = get_depot();
+        return statistics{depot.slabs_allocated.load(std::memory_order_relaxed),
+                          depot.large_allocations.load(std::memory_order_relaxed)};
+    }
+
+private:
+    using mutex_type = std::mutex;
+    using lock_type = std::unique_lock<mutex_type>;
+
+    struct free_block {
+        free_block *next;
+    };
+
+    struct free_list {
+        void push(free_block *block) {
+            block->next = head;
+            head = block;
+            ++count;
+        }
+
+        free_block *head;
+        std::size_t count;
+    };
+
+    // trivially destructible so that it remains usable while other thread_local destructors run
+    struct cache_type {
+        free_list lists[size_class_count];
+        bool flushed;
+        bool registered;
+    };
+
+    struct depot_type {
+        mutex_type mutex;
+        free_list lists[size_class_count] = {};
+        std::atomic<std::size_t> slabs_allocated{0};
+        std::atomic<std::size_t> large_allocations{0};
+    };
+
+    // returns the calling thread's blocks to the depot when the thread exits
+    struct thread_exit_flusher {
+        ~thread_exit_flusher() {
+            auto &cache = thread_cache();
+            for (std::size_t cls = 0; cls < size_class_count; ++cls) {
+                auto &list = cache.lists[cls];
+                drain(list, cls, list.count);
+            }
+            cache.flushed = true;
+        }
+    };
+
+    static auto size_class(std::size_t bytes) -> std::size_t {
+        return bytes ? (bytes - 1) / granularity : 0;
+    }
+
+    static auto block_size(std::size_t cls) -> std::size_t {
+        return (cls + 1) * granularity;
+    }
+
+    static auto thread_cache() -> cache_type & {
+        static thread_local cache_type cache = {};
+        return cache;
+    }
+
+    // intentionally leaked so that blocks may be returned during static destruction
+    static auto get_depot() -> depot_type & {
+        static depot_type *depot = new depot_type();
+        return *depot;
+    }
+
+    // the calling thread's cache, arranging on first use from either path for it to be flushed at thread exit
+    static auto this_thread_cache() -> cache_type & {
+        auto &cache = thread_cache();
+        if (not cache.registered) {
+            cache.registered = true;
+            static thread_local thread_exit_flusher flusher;
+            (void) flusher;
+        }
+        return cache;
+    }
+
+    static void refill(cache_type &cache, std::size_t cls) {
+        auto &list = cache.lists[cls];
+        auto &depot = get_depot();
+        {
+            auto lock = lock_type(depot.mutex);
+            auto &shared = depot.lists[cls];
+            for (std::size_t i = 0; i < transfer_batch and shared.head; ++i) {
+                auto block = shared.head;
+                shared.head = block->next;
+                --shared.count;
+                list.push(block);
+            }
+        }
+        if (list.head) return;
+
+        // carve a new slab into blocks of this class
+        auto size = block_size(cls);
+        auto slab = static_cast<char *>(::operator new(slab_bytes));
+        depot.slabs_allocated.fetch_add(1, std::memory_order_relaxed);
+        for (auto offset = slab_bytes - slab_bytes % size; offset >= size; offset -= size) {
+            list.push(reinterpret_cast<free_block *>(slab + offset - size));
+        }
+    }
+
+    static void drain(free_list &list, std::size_t cls, std::size_t count) {
+        if (not count) return;
+        auto &depot = get_depot();
+        auto lock = lock_type(depot.mutex);
+        auto &shared = depot.lists[cls];
+        while (count-- and list.head) {
+            auto block = list.head;
+            list.head = block->next;
+            --list.count;
+            shared.push(block);
+        }
+    }
+};
+
+/** A standard allocator which draws its storage from the slab_pool */
+template<class T>
+struct pooled_allocator {
+    using value_type = T;
+
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported by the slab_pool");
+
+    pooled_allocator() noexcept = default;
+
+    template<class U>
+    pooled_allocator(pooled_allocator<U> const &) noexcept {}
+
+    auto allocate(std::size_t n) -> T * {
+        return static_cast<T *>(slab_pool::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        slab_pool::deallocate(p, n * sizeof(T));
+    }
+
+    template<class U>
+    bool operator==(pooled_allocator<U> const &) const noexcept { return true; }
+
+    template<class U>
+    bool operator!=(pooled_allocator<U> const &) const noexcept { return false; }
+};
@@ -1,10 +1,46 @@
 sugar_files(SOURCE_FILES config.hpp
+        asio_executor.hpp
+        async_completion_handler.hpp
+        chunk_directory.hpp
+        completion_batch.hpp
+        goblin.hpp
+        goblin_allocation.hpp
+        goblin_group.hpp
+        goblin_group_state.hpp
+        goblin_horde.hpp
+        goblin_host.hpp
         goblin_impl.hpp
+        goblin_kill_stream.hpp
+        goblin_kills.hpp
+        goblin_link.hpp
+        goblin_mailbox.hpp
+        goblin_metrics.hpp
         goblin_error.hpp
+        goblin_name.hpp
         goblin_name_generator.hpp
+        goblin_registry.hpp
+        goblin_remote_impl.hpp
+        goblin_service.hpp
+        goblin_shm_ring.hpp
+        goblin_simulation.hpp
+        goblin_slot_map.hpp
         goblin_state.hpp
-        main.cpp
+        goblin_trace.hpp
+        goblin_trace_format.hpp
+        goblin_wire.hpp
+        goblin_world.hpp
+        impl_proxy.hpp
+        use_goblin_awaitable.hpp
+        use_goblin_future.hpp
         use_unique_future.hpp
         run_pool.hpp
+        slab_pool.hpp
+        table_state_machine.hpp
+        timing_wheel_service.hpp
+        unique_handler.hpp
+        virtual_clock_service.hpp
+        work_stealing_pool.hpp
+        work_stealing_service.hpp
         worker_thread_service.hpp)
+sugar_files(TIGGLE_SOURCES main.cpp)
 sugar_include(goblin_state)
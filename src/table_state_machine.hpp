@@ -0,0 +1,250 @@
+#pragma once
+
+#include <boost/msm/back/state_machine.hpp>
+#include <boost/msm/front/functor_row.hpp>
+#include <boost/mpl/at.hpp>
+#include <boost/mpl/begin_end.hpp>
+#include <boost/mpl/contains.hpp>
+#include <boost/mpl/distance.hpp>
+#include <boost/mpl/find.hpp>
+#include <boost/mpl/fold.hpp>
+#include <boost/mpl/if.hpp>
+#include <boost/mpl/or.hpp>
+#include <boost/mpl/push_back.hpp>
+#include <boost/mpl/size.hpp>
+#include <boost/mpl/vector.hpp>
+
+#include <cstddef>
+#include <exception>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace detail {
+
+    template<class Row>
+    struct table_row;
+
+    template<class Source, class Event, class Target, class Action, class Guard>
+    struct table_row<boost::msm::front::Row<Source, Event, Target, Action, Guard>> {
+        using source = Source;
+        using event = Event;
+        using target = Target;
+        using action = Action;
+        using guard = Guard;
+
+        /** a row without a target is an internal transition: the state is neither left nor re-entered */
+        static constexpr bool internal = std::is_same<Target, boost::msm::front::none>::value;
+    };
+
+    template<class States, class State>
+    using add_state = typename boost::mpl::if_<
+            boost::mpl::or_<std::is_same<State, boost::msm::front::none>, boost::mpl::contains<States, State>>,
+            States,
+            typename boost::mpl::push_back<States, State>::type>::type;
+
+    template<class States, class Row>
+    struct add_row_states {
+        using type = add_state<add_state<States, typename table_row<Row>::source>, typename table_row<Row>::target>;
+    };
+
+    /** Every state named by the table, the initial state first and the rest in order of appearance */
+    template<class Table, class Initial>
+    using table_states = typename boost::mpl::fold<
+            Table, boost::mpl::vector<Initial>, add_row_states<boost::mpl::_1, boost::mpl::_2>>::type;
+
+    template<class...>
+    struct type_list {};
+}
+
+/** A state machine back-end for an msm functor front-end, dispatching through a flat jump table.
+ *
+ * It reads the same front-end as msmb::state_machine: the transition_table of msmf::Row, the states' on_entry
+ * and on_exit, their flag_list, and the front-end's on_exit, no_transition and exception_caught. For each event
+ * type it builds, at compile time, one function per state which runs the rows for that state and event. Processing
+ * an event is then one indexed call, with no search of the table and no per-region bookkeeping.
+ *
+ * Only what the goblins use is supported: a single region, Row transitions with optional guards (tried in table
+ * order), and no deferred events, completion transitions, sub-machines or internal_transition_table.
+ */
+template<class Front>
+class table_state_machine : public Front {
+public:
+    using front_type = Front;
+    using transition_table = typename Front::transition_table;
+    using states = detail::table_states<transition_table, typename Front::initial_state>;
+
+    static constexpr int state_count = boost::mpl::size<states>::value;
+
+    /** The id of a state, as returned in current_state()[0] */
+    template<class State>
+    struct state_id : std::integral_constant<int, boost::mpl::distance<
+            typename boost::mpl::begin<states>::type,
+            typename boost::mpl::find<states, State>::type>::value> {};
+
+    /** The event passed to on_entry and on_exit by start() and stop() */
+    struct start_event {};
+    struct stop_event {};
+
+    template<class...Args>
+    explicit table_state_machine(Args &&...args) : Front(std::forward<Args>(args)...) {}
+
+    void start() {
+        start_event const event{};
+        state_ = state_id<typename Front::initial_state>::value;
+        this->Front::on_entry(event, *this);
+        get_state<typename Front::initial_state>().on_entry(event, *this);
+    }
+
+    void stop() {
+        stop_event const event{};
+        visit_current([&](auto &state) { state.on_exit(event, *this); });
+        this->Front::on_exit(event, *this);
+    }
+
+    /** @return false if no row accepted the event, in which case no_transition has been called */
+    template<class Event>
+    bool process_event(Event const &event) {
+        auto handlers = jump_table<Event>(std::make_index_sequence<state_count>());
+        try {
+            if (handlers[state_](*this, event)) return true;
+            this->no_transition(event, *this, state_);
+        }
+        catch (std::exception &e) {
+            this->exception_caught(event, *this, e);
+        }
+        return false;
+    }
+
+    auto current_state() const -> int const * { return &state_; }
+
+    template<class Flag>
+    bool is_flag_active() const {
+        return flag_table<Flag>(std::make_index_sequence<state_count>())[state_];
+    }
+
+    template<class State>
+    auto get_state() -> State & {
+        return std::get<state_id<State>::value>(states_);
+    }
+
+private:
+    template<int S>
+    using state_at = typename boost::mpl::at_c<states, S>::type;
+
+    template<class Sequence>
+    struct as_tuple;
+
+    template<std::size_t...Is>
+    struct as_tuple<std::index_sequence<Is...>> {
+        using type = std::tuple<state_at<int(Is)>...>;
+    };
+
+    template<class Event, std::size_t...Is>
+    static auto jump_table(std::index_sequence<Is...>) -> bool (*const *)(table_state_machine &, Event const &) {
+        static constexpr bool (*table[])(table_state_machine &, Event const &) = {&dispatch<Event, int(Is)>...};
+        return table;
+    }
+
+    template<class Flag, std::size_t...Is>
+    static auto flag_table(std::index_sequence<Is...>) -> bool const * {
+        static constexpr bool table[] = {
+                boost::mpl::contains<typename state_at<int(Is)>::flag_list, Flag>::value...
+        };
+        return table;
+    }
+
+    /** The rows with the given source state and event, in table order */
+    template<class Event, class Source>
+    struct matching_rows {
+        template<class List, class Row>
+        struct add;
+
+        template<class...Rows, class Row>
+        struct add<detail::type_list<Rows...>, Row> {
+            using info = detail::table_row<Row>;
+            using type = std::conditional_t<
+                    std::is_same<typename info::source, Source>::value
+                    and std::is_same<typename info::event, Event>::value,
+                    detail::type_list<Rows..., Row>,
+                    detail::type_list<Rows...>>;
+        };
+
+        using type = typename boost::mpl::fold<
+                transition_table, detail::type_list<>, add<boost::mpl::_1, boost::mpl::_2>>::type;
+    };
+
+    template<class Event, int S>
+    static bool dispatch(table_state_machine &fsm, Event const &event) {
+        return fsm.try_rows(event, typename matching_rows<Event, state_at<S>>::type());
+    }
+
+    template<class Event>
+    bool try_rows(Event const &, detail::type_list<>) {
+        return false;
+    }
+
+    template<class Event, class Row, class...Rows>
+    bool try_rows(Event const &event, detail::type_list<Row, Rows...>) {
+        if (run_row(event, detail::table_row<Row>())) return true;
+        return try_rows(event, detail::type_list<Rows...>());
+    }
+
+    template<class Event, class Row>
+    bool run_row(Event const &event, Row) {
+        using source_type = typename Row::source;
+        using target_type = std::conditional_t<Row::internal, source_type, typename Row::target>;
+        auto &source = get_state<source_type>();
+        auto &target = get_state<target_type>();
+
+        if (not check_guard(typename Row::guard(), event, source, target)) return false;
+
+        if (Row::internal) {
+            run_action(typename Row::action(), event, source, target);
+        } else {
+            source.on_exit(event, *this);
+            run_action(typename Row::action(), event, source, target);
+            state_ = state_id<target_type>::value;
+            target.on_entry(event, *this);
+        }
+        return true;
+    }
+
+    template<class Event, class Source, class Target>
+    bool check_guard(boost::msm::front::none, Event const &, Source &, Target &) { return true; }
+
+    template<class Guard, class Event, class Source, class Target>
+    bool check_guard(Guard guard, Event const &event, Source &source, Target &target) {
+        return guard(event, *this, source, target);
+    }
+
+    template<class Event, class Source, class Target>
+    void run_action(boost::msm::front::none, Event const &, Source &, Target &) {}
+
+    template<class Action, class Event, class Source, class Target>
+    void run_action(Action action, Event const &event, Source &source, Target &target) {
+        action(event, *this, source, target);
+    }
+
+    template<class F, std::size_t...Is>
+    void visit_current(F &&f, std::index_sequence<Is...>) {
+        using expand = int[];
+        void(expand{0, (state_ == int(Is) ? (f(std::get<Is>(states_)), 0) : 0)...});
+    }
+
+    template<class F>
+    void visit_current(F &&f) {
+        visit_current(std::forward<F>(f), std::make_index_sequence<state_count>());
+    }
+
+    typename as_tuple<std::make_index_sequence<state_count>>::type states_;
+    int state_ = state_id<typename Front::initial_state>::value;
+};
+
+/** The id a state machine back-end gives a state, as found in current_state()[0] */
+template<class FSM, class State>
+struct fsm_state_id : boost::msm::back::get_state_id<typename FSM::stt, State> {};
+
+template<class Front, class State>
+struct fsm_state_id<table_state_machine<Front>, State>
+        : table_state_machine<Front>::template state_id<State> {};
@@ -0,0 +1,355 @@
+#pragma once
+
+#include "config.hpp"
+#include "unique_handler.hpp"
+#include "virtual_clock_service.hpp"
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct timing_wheel_service;
+class goblin_simulation;
+
+/** The intrusive list links which place a wheel_timer in one of the wheel's slots */
+struct wheel_link {
+    wheel_link *prev_ = nullptr;
+    wheel_link *next_ = nullptr;
+};
+
+/** A one-shot timer registered with the timing_wheel_service of an io_service.
+ * Scheduling and cancelling are O(1). A timer is neither copyable nor movable since the wheel links to it.
+ * Destroying a timer cancels it.
+ */
+struct wheel_timer : private wheel_link {
+    using clock_type = std::chrono::steady_clock;
+    using duration = clock_type::duration;
+    using handler_type = unique_handler<void()>;
+
+    explicit wheel_timer(asio::io_service &executor);
+
+    wheel_timer(wheel_timer const &) = delete;
+
+    wheel_timer &operator=(wheel_timer const &) = delete;
+
+    ~wheel_timer() { cancel(); }
+
+    /** Arrange for handler() to be called on the wheel's io_service once the duration has elapsed,
+     * replacing any wait already pending. A cancelled handler is destroyed without being called.
+     * The handler need not be copyable.
+     */
+    template<class Handler>
+    void async_wait_for(duration d, Handler &&handler);
+
+    /** @return true if a pending wait was cancelled */
+    bool cancel();
+
+    /** The time according to the wheel: virtual time in a simulation, otherwise the steady clock's */
+    auto now() const -> clock_type::time_point;
+
+private:
+    friend timing_wheel_service;
+
+    timing_wheel_service *service_;
+    std::uint64_t expiry_ = 0;
+    std::size_t level_ = 0;
+    handler_type handler_;
+};
+
+/** A hierarchical timing wheel which multiplexes any number of wheel_timers onto one asio timer.
+ *
+ * The wheel has four levels of 256 slots. Level 0 holds timers due within 256 ticks, one slot per tick. Each
+ * higher level covers 256 times the span of the one below, and its slots are cascaded down a level as the
+ * wheel turns. A timer is inserted in, and removed from, a slot's intrusive list in constant time no matter
+ * how many timers exist. The asio timer is only armed for the next tick on which there is work to do.
+ *
+ * Expired timers are collected under the wheel's lock and their handlers run afterwards, so handlers may freely
+ * schedule or cancel other timers. A large batch is split into chunks of dispatch_chunk handlers, all but the
+ * first posted back to the io_service, so that every thread running it shares the work of a busy tick.
+ *
+ * If the io_service has a virtual_clock_service when the wheel is created, the wheel keeps virtual time and
+ * is turned by a goblin_simulation instead of by the asio timer.
+ */
+struct timing_wheel_service : asio::detail::service_base<timing_wheel_service> {
+    using clock_type = wheel_timer::clock_type;
+    using duration = wheel_timer::duration;
+
+    static constexpr std::size_t level_count = 4;
+    static constexpr std::size_t slot_bits = 8;
+    static constexpr std::size_t slot_count = std::size_t(1) << slot_bits;
+    static constexpr std::uint64_t slot_mask = slot_count - 1;
+    static constexpr std::size_t dispatch_chunk = 64;
+
+    timing_wheel_service(asio::io_service &owner)
+            : asio::detail::service_base<timing_wheel_service>(owner),
+              clock_(asio::has_service<virtual_clock_service>(owner)
+                     ? std::addressof(asio::use_service<virtual_clock_service>(owner))
+                     : nullptr),
+              epoch_(now()),
+              ticker_(owner) {
+        for (auto &level : levels_) {
+            for (auto &slot : level) {
+                slot.prev_ = slot.next_ = &slot;
+            }
+        }
+    }
+
+    /** The granularity of the wheel. Timers fire on the first tick at or after their due time. */
+    static constexpr auto resolution() -> duration { return std::chrono::milliseconds(1); }
+
+    auto now() const -> clock_type::time_point {
+        return clock_ ? clock_->now() : clock_type::now();
+    }
+
+    auto size() const -> std::size_t {
+        auto lock = lock_type(mutex_);
+        std::size_t result = 0;
+        for (auto n : level_sizes_) result += n;
+        return result;
+    }
+
+private:
+    friend wheel_timer;
+    friend goblin_simulation;
+
+    using mutex_type = std::mutex;
+    using lock_type = std::unique_lock<mutex_type>;
+    using handler_batch = std::vector<wheel_timer::handler_type>;
+
+    void schedule(wheel_timer &timer, duration d, wheel_timer::handler_type handler) {
+        wheel_timer::handler_type cancelled;
+        auto lock = lock_type(mutex_);
+        if (shut_down_) return;
+        if (timer.next_) {
+            unlink(timer);
+            cancelled = std::move(timer.handler_);
+        }
+        auto now = now_tick();
+        if (empty()) {
+            // nothing is pending, so there are no intermediate ticks to process
+            current_tick_ = std::max(current_tick_, now);
+        }
+        auto ticks = (d.count() <= 0) ? 0 : (d + resolution() - duration(1)) / resolution();
+        timer.expiry_ = std::max(now + std::uint64_t(ticks), current_tick_ + 1);
+        timer.handler_ = std::move(handler);
+        link(timer);
+        if (not armed_ or timer.expiry_ < armed_tick_) {
+            arm(timer.expiry_);
+        }
+    }
+
+    bool cancel(wheel_timer &timer) {
+        wheel_timer::handler_type cancelled;
+        auto lock = lock_type(mutex_);
+        if (not timer.next_) return false;
+        unlink(timer);
+        cancelled = std::move(timer.handler_);
+        lock.unlock();
+        // destroy the handler outside the lock; it may own the object which owns the timer
+        return true;
+    }
+
+    void shutdown_service() override {
+        handler_batch abandoned;
+        auto lock = lock_type(mutex_);
+        shut_down_ = true;
+        for (auto &level : levels_) {
+            for (auto &slot : level) {
+                take_all(slot, abandoned);
+            }
+        }
+        ticker_.cancel();
+        lock.unlock();
+    }
+
+    auto now_tick() const -> std::uint64_t {
+        return std::uint64_t((now() - epoch_) / resolution());
+    }
+
+    bool empty() const {
+        for (auto n : level_sizes_) if (n) return false;
+        return true;
+    }
+
+    void link(wheel_timer &timer) {
+        wheel_link &node = timer;
+        auto delta = timer.expiry_ - std::min(timer.expiry_, current_tick_);
+        std::size_t level = 0;
+        while (level + 1 < level_count and delta >= (std::uint64_t(1) << (slot_bits * (level + 1)))) {
+            ++level;
+        }
+        // timers beyond the span of the top level wait in the furthest slot and are re-filed when cascaded
+        auto position = timer.expiry_;
+        auto span = std::uint64_t(1) << (slot_bits * level_count);
+        if (delta >= span) position = current_tick_ + span - 1;
+
+        auto &head = levels_[level][(position >> (slot_bits * level)) & slot_mask];
+        node.prev_ = head.prev_;
+        node.next_ = &head;
+        head.prev_->next_ = &node;
+        head.prev_ = &node;
+        timer.level_ = level;
+        ++level_sizes_[level];
+    }
+
+    void unlink(wheel_timer &timer) {
+        timer.prev_->next_ = timer.next_;
+        timer.next_->prev_ = timer.prev_;
+        timer.prev_ = timer.next_ = nullptr;
+        --level_sizes_[timer.level_];
+    }
+
+    static auto timer_at(wheel_link *link) -> wheel_timer & {
+        return static_cast<wheel_timer &>(*link);
+    }
+
+    void take_all(wheel_link &head, handler_batch &batch) {
+        while (head.next_ != &head) {
+            auto &timer = timer_at(head.next_);
+            unlink(timer);
+            batch.push_back(std::move(timer.handler_));
+        }
+    }
+
+    void cascade(std::size_t level) {
+        auto &head = levels_[level][(current_tick_ >> (slot_bits * level)) & slot_mask];
+        while (head.next_ != &head) {
+            auto &timer = timer_at(head.next_);
+            unlink(timer);
+            link(timer);
+        }
+    }
+
+    /** Process every tick up to and including target, collecting the handlers of expired timers */
+    void advance(std::uint64_t target, handler_batch &batch) {
+        while (current_tick_ < target) {
+            // skip straight to the next cascade of the lowest level which holds any timers
+            std::size_t empty_levels = 0;
+            while (empty_levels < level_count and level_sizes_[empty_levels] == 0) ++empty_levels;
+            if (empty_levels == level_count) {
+                current_tick_ = target;
+                break;
+            }
+            if (empty_levels) {
+                auto skip_to = current_tick_ | ((std::uint64_t(1) << (slot_bits * empty_levels)) - 1);
+                if (skip_to >= target) {
+                    current_tick_ = target;
+                    break;
+                }
+                current_tick_ = skip_to;
+            }
+
+            ++current_tick_;
+            for (std::size_t level = 1; level < level_count; ++level) {
+                if ((current_tick_ & ((std::uint64_t(1) << (slot_bits * level)) - 1)) != 0) break;
+                cascade(level);
+            }
+            take_all(levels_[0][current_tick_ & slot_mask], batch);
+        }
+    }
+
+    /** The earliest tick at which advance() could find work to do. Only valid if not empty(). */
+    auto next_tick() const -> std::uint64_t {
+        auto result = ~std::uint64_t(0);
+        for (std::size_t level = 0; level < level_count; ++level) {
+            if (not level_sizes_[level]) continue;
+            auto shift = slot_bits * level;
+            auto index = (current_tick_ >> shift) & slot_mask;
+            for (std::uint64_t distance = 1; distance <= slot_count; ++distance) {
+                auto &head = levels_[level][(index + distance) & slot_mask];
+                if (head.next_ != &head) {
+                    auto base = ((current_tick_ >> shift) + distance) << shift;
+                    result = std::min(result, base);
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+
+    void arm(std::uint64_t tick) {
+        armed_ = true;
+        armed_tick_ = tick;
+        // in virtual time the simulation asks next_due() when to turn the wheel
+        if (clock_) return;
+        ticker_.expires_at(epoch_ + tick * resolution());
+        ticker_.async_wait([this](asio::error_code const &ec) {
+            if (ec != asio::error::operation_aborted) {
+                on_tick();
+            }
+        });
+    }
+
+    /** When the wheel next has work to do, if it has any. Only meaningful in virtual time. */
+    bool next_due(clock_type::time_point &when) const {
+        auto lock = lock_type(mutex_);
+        // cancelling a timer leaves the wheel armed, but there is no reason to move the clock for nothing
+        if (shut_down_ or not armed_ or empty()) return false;
+        when = epoch_ + armed_tick_ * resolution();
+        return true;
+    }
+
+    void on_tick() {
+        handler_batch batch;
+        auto lock = lock_type(mutex_);
+        if (shut_down_) return;
+        armed_ = false;
+        advance(now_tick(), batch);
+        if (not empty()) {
+            arm(next_tick());
+        }
+        lock.unlock();
+
+        dispatch(std::move(batch));
+    }
+
+    /** Post all but the first chunk of the batch to the io_service, then run the first here */
+    void dispatch(handler_batch batch) {
+        auto chunk_end = [&batch](std::size_t start) {
+            return batch.begin() + std::ptrdiff_t(std::min(batch.size(), start + dispatch_chunk));
+        };
+        for (auto start = dispatch_chunk; start < batch.size(); start += dispatch_chunk) {
+            // shared, because the io_service may copy the handlers posted to it
+            auto chunk = std::make_shared<handler_batch>(std::make_move_iterator(batch.begin() + std::ptrdiff_t(start)),
+                                                         std::make_move_iterator(chunk_end(start)));
+            get_io_service().post([chunk] {
+                for (auto &handler : *chunk) handler();
+            });
+        }
+        for (auto it = batch.begin(); it != chunk_end(0); ++it) {
+            (*it)();
+        }
+    }
+
+    mutable mutex_type mutex_;
+    virtual_clock_service *clock_;
+    clock_type::time_point epoch_;
+    std::uint64_t current_tick_ = 0;
+    std::array<std::array<wheel_link, slot_count>, level_count> levels_{};
+    std::array<std::size_t, level_count> level_sizes_{};
+    asio::steady_timer ticker_;
+    bool armed_ = false;
+    std::uint64_t armed_tick_ = 0;
+    bool shut_down_ = false;
+};
+
+inline wheel_timer::wheel_timer(asio::io_service &executor)
+        : service_(std::addressof(asio::use_service<timing_wheel_service>(executor))) {}
+
+template<class Handler>
+void wheel_timer::async_wait_for(duration d, Handler &&handler) {
+    service_->schedule(*this, d, handler_type(std::forward<Handler>(handler)));
+}
+
+inline bool wheel_timer::cancel() {
+    return service_->cancel(*this);
+}
+
+inline auto wheel_timer::now() const -> clock_type::time_point {
+    return service_->now();
+}
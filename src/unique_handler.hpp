@@ -0,0 +1,159 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <boost/asio/detail/handler_alloc_helpers.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template<class Signature>
+class unique_handler;
+
+/** A move-only, type-erased completion handler.
+ *
+ * Unlike std::function, a unique_handler can hold handlers which cannot be copied, and is never copied itself.
+ * Handlers of up to buffer_size bytes which can be moved without throwing are stored inline, so holding one
+ * does not allocate. Larger handlers are stored in memory obtained through the handler's own asio allocation
+ * hooks (asio_handler_allocate/asio_handler_deallocate).
+ */
+template<class R, class...Args>
+class unique_handler<R(Args...)> {
+public:
+    static constexpr std::size_t buffer_size = 64;
+
+    unique_handler() noexcept = default;
+
+    unique_handler(std::nullptr_t) noexcept {}
+
+    template<class Handler, class = std::enable_if_t<not std::is_same<std::decay_t<Handler>, unique_handler>::value>>
+    unique_handler(Handler &&handler)
+            : ops_(model<std::decay_t<Handler>>::operations_table()) {
+        model<std::decay_t<Handler>>::construct(storage_, std::forward<Handler>(handler));
+    }
+
+    unique_handler(unique_handler &&other) noexcept
+            : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(other.storage_, storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    unique_handler &operator=(unique_handler &&other) noexcept {
+        if (this != std::addressof(other)) {
+            reset();
+            if (other.ops_) {
+                other.ops_->move(other.storage_, storage_);
+                ops_ = std::exchange(other.ops_, nullptr);
+            }
+        }
+        return *this;
+    }
+
+    unique_handler(unique_handler const &) = delete;
+
+    unique_handler &operator=(unique_handler const &) = delete;
+
+    ~unique_handler() { reset(); }
+
+    void reset() noexcept {
+        if (ops_) {
+            std::exchange(ops_, nullptr)->destroy(storage_);
+        }
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    R operator()(Args...args) {
+        return ops_->invoke(storage_, std::forward<Args>(args)...);
+    }
+
+private:
+    using storage_type = std::aligned_storage_t<buffer_size, alignof(std::max_align_t)>;
+
+    struct operations {
+        R (*invoke)(storage_type &, Args &&...);
+
+        void (*move)(storage_type &from, storage_type &to) noexcept;
+
+        void (*destroy)(storage_type &) noexcept;
+    };
+
+    template<class Handler, bool Inline = (sizeof(Handler) <= buffer_size
+                                           and alignof(Handler) <= alignof(std::max_align_t)
+                                           and std::is_nothrow_move_constructible<Handler>::value)>
+    struct model;
+
+    template<class Handler>
+    struct model<Handler, true> {
+        static auto get(storage_type &s) -> Handler & { return *reinterpret_cast<Handler *>(&s); }
+
+        template<class Arg>
+        static void construct(storage_type &s, Arg &&arg) {
+            ::new(&s) Handler(std::forward<Arg>(arg));
+        }
+
+        static R invoke(storage_type &s, Args &&...args) {
+            return get(s)(std::forward<Args>(args)...);
+        }
+
+        static void move(storage_type &from, storage_type &to) noexcept {
+            ::new(&to) Handler(std::move(get(from)));
+            get(from).~Handler();
+        }
+
+        static void destroy(storage_type &s) noexcept {
+            get(s).~Handler();
+        }
+
+        static auto operations_table() -> operations const * {
+            static constexpr operations table{&invoke, &move, &destroy};
+            return &table;
+        }
+    };
+
+    template<class Handler>
+    struct model<Handler, false> {
+        static auto get(storage_type &s) -> Handler *& { return *reinterpret_cast<Handler **>(&s); }
+
+        template<class Arg>
+        static void construct(storage_type &s, Arg &&arg) {
+            auto memory = boost_asio_handler_alloc_helpers::allocate(sizeof(Handler), arg);
+            try {
+                get(s) = ::new(memory) Handler(std::forward<Arg>(arg));
+            }
+            catch (...) {
+                boost_asio_handler_alloc_helpers::deallocate(memory, sizeof(Handler), arg);
+                throw;
+            }
+        }
+
+        static R invoke(storage_type &s, Args &&...args) {
+            return (*get(s))(std::forward<Args>(args)...);
+        }
+
+        static void move(storage_type &from, storage_type &to) noexcept {
+            get(to) = std::exchange(get(from), nullptr);
+        }
+
+        static void destroy(storage_type &s) noexcept {
+            auto p = get(s);
+            // the hooks may depend on the handler's state, so keep that alive until the memory is returned
+            auto local = Handler(std::move(*p));
+            p->~Handler();
+            boost_asio_handler_alloc_helpers::deallocate(p, sizeof(Handler), local);
+        }
+
+        static auto operations_table() -> operations const * {
+            static constexpr operations table{&invoke, &move, &destroy};
+            return &table;
+        }
+    };
+
+    operations const *ops_ = nullptr;
+    storage_type storage_;
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "config.hpp"
+
+#if defined(__cpp_impl_coroutine)
+
+#include "slab_pool.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+/// @brief Class used to indicate an asynchronous operation should return something a coroutine can co_await.
+class use_goblin_awaitable_t {};
+
+/// @brief A special value, similar to use_goblin_future.
+constexpr use_goblin_awaitable_t use_goblin_awaitable {};
+
+namespace detail {
+
+    /** Where the completion of an operation meets the coroutine awaiting it.
+     *
+     * It holds only the error and the coroutine's handle, in one slab_pool allocation. The completion and the
+     * coroutine's suspension each set a bit in status_, and whichever sets the second bit resumes the coroutine,
+     * so no lock is taken. As with future_state, the handler may be copied and the first copy to complete wins.
+     */
+    struct awaitable_state {
+        static constexpr std::uint32_t completed = 1;
+        static constexpr std::uint32_t suspended = 2;
+        static constexpr std::uint32_t claimed = 4;
+
+        static auto create() -> awaitable_state * {
+            auto storage = slab_pool::allocate(sizeof(awaitable_state));
+            return ::new(storage) awaitable_state();
+        }
+
+        void add_ref() noexcept { references_.fetch_add(1, std::memory_order_relaxed); }
+
+        void add_producer() noexcept { producers_.fetch_add(1, std::memory_order_relaxed); }
+
+        /** @return true if that was the last producer */
+        bool drop_producer() noexcept { return producers_.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+        void release() noexcept {
+            if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                this->~awaitable_state();
+                slab_pool::deallocate(this, sizeof(awaitable_state));
+            }
+        }
+
+        /** Record the result, and resume the coroutine here if it is already suspended.
+         * Has no effect if the operation has already completed. */
+        void complete(asio::error_code const &error) {
+            if (status_.fetch_or(claimed, std::memory_order_acquire) & claimed) return;
+            error_ = error;
+            if (status_.fetch_or(completed, std::memory_order_acq_rel) & suspended) {
+                waiter_.resume();
+            }
+        }
+
+        bool is_complete() const { return status_.load(std::memory_order_acquire) & completed; }
+
+        /** @return false if the operation completed meanwhile, in which case the coroutine carries on at once */
+        bool suspend(std::coroutine_handle<> waiter) {
+            waiter_ = waiter;
+            return not(status_.fetch_or(suspended, std::memory_order_acq_rel) & completed);
+        }
+
+        auto error() const -> asio::error_code const & { return error_; }
+
+    private:
+        awaitable_state() = default;
+
+        ~awaitable_state() = default;
+
+        std::atomic<std::uint32_t> references_{2};
+        std::atomic<std::uint32_t> producers_{1};
+        std::atomic<std::uint32_t> status_{0};
+        asio::error_code error_;
+        std::coroutine_handle<> waiter_;
+    };
+
+    /// @brief Completion handler which resumes the coroutine awaiting the operation.
+    template<class T>
+    class awaitable_handler;
+
+    template<>
+    class awaitable_handler<void> {
+    public:
+        explicit awaitable_handler(use_goblin_awaitable_t)
+                : state_(awaitable_state::create()) {}
+
+        awaitable_handler(awaitable_handler const &other) noexcept : state_(other.state_) {
+            if (state_) {
+                state_->add_ref();
+                state_->add_producer();
+            }
+        }
+
+        awaitable_handler(awaitable_handler &&other) noexcept : state_(std::exchange(other.state_, nullptr)) {}
+
+        awaitable_handler &operator=(awaitable_handler const &) = delete;
+
+        /** If the operation is abandoned without completing, e.g. when the io_service is destroyed, the coroutine
+         * is resumed with operation_aborted rather than left suspended for ever. */
+        ~awaitable_handler() {
+            if (not state_) return;
+            if (state_->drop_producer()) {
+                state_->complete(asio::error::operation_aborted);
+            }
+            state_->release();
+        }
+
+        void operator()(asio::error_code const &error) {
+            state_->complete(error);
+        }
+
+        /** Called once by async_result. The state was created with a reference for it. */
+        auto take_state() -> awaitable_state * { return state_; }
+
+    private:
+        awaitable_state *state_;
+    };
+}
+
+template<class T>
+class goblin_awaitable;
+
+/** The result of an operation initiated with use_goblin_awaitable. co_await it once.
+ *
+ * The awaiting coroutine is resumed by the operation's completion handler, i.e. on the goblin service's
+ * completion executor for goblin operations, or straight away if the operation has already completed.
+ * co_await throws boost::system::system_error if the operation failed.
+ */
+template<>
+class goblin_awaitable<void> {
+public:
+    goblin_awaitable() noexcept = default;
+
+    explicit goblin_awaitable(detail::awaitable_state *state) noexcept : state_(state) {}
+
+    goblin_awaitable(goblin_awaitable &&other) noexcept : state_(std::exchange(other.state_, nullptr)) {}
+
+    goblin_awaitable &operator=(goblin_awaitable &&other) noexcept {
+        std::swap(state_, other.state_);
+        return *this;
+    }
+
+    ~goblin_awaitable() {
+        if (state_) state_->release();
+    }
+
+    bool await_ready() const noexcept { return state_->is_complete(); }
+
+    bool await_suspend(std::coroutine_handle<> waiter) noexcept { return state_->suspend(waiter); }
+
+    void await_resume() const {
+        if (auto const &error = state_->error()) {
+            throw boost::system::system_error(error);
+        }
+    }
+
+private:
+    detail::awaitable_state *state_ = nullptr;
+};
+
+/** The return type of a detached coroutine which awaits goblin operations.
+ *
+ * The coroutine starts running at once, in the calling thread, and its frame is freed when it finishes. Like a
+ * std::thread, an exception escaping the coroutine calls std::terminate.
+ */
+struct goblin_task {
+    struct promise_type {
+        auto get_return_object() noexcept -> goblin_task { return {}; }
+
+        auto initial_suspend() noexcept -> std::suspend_never { return {}; }
+
+        auto final_suspend() noexcept -> std::suspend_never { return {}; }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+namespace boost {
+namespace asio {
+
+/// @brief Handler type specialization for use_goblin_awaitable.
+template <typename ReturnType>
+struct handler_type<
+    use_goblin_awaitable_t,
+    ReturnType(boost::system::error_code)>
+{
+  typedef ::detail::awaitable_handler<void> type;
+};
+
+/// @brief Handler traits specialization for awaitable_handler.
+template <typename T>
+class async_result< ::detail::awaitable_handler<T> >
+{
+public:
+  // The initiating function will return a goblin_awaitable.
+  typedef goblin_awaitable<T> type;
+
+  explicit async_result(::detail::awaitable_handler<T>& handler)
+    : value_(handler.take_state())
+  {}
+
+  // Obtain the awaitable to be returned from the initiating function.
+  type get() { return std::move(value_); }
+
+private:
+  type value_;
+};
+
+} // namespace asio
+} // namespace boost
+
+#endif
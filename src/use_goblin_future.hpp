@@ -0,0 +1,377 @@
+#pragma once
+
+#include "config.hpp"
+#include "slab_pool.hpp"
+#include "unique_handler.hpp"
+
+#include <boost/optional.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+/// @brief Class used to indicate an asynchronous operation should return a goblin_future.
+class use_goblin_future_t {};
+
+/// @brief A special value, similar to use_unique_future.
+constexpr use_goblin_future_t use_goblin_future {};
+
+template<class T>
+class goblin_future;
+
+namespace detail {
+
+    struct void_value {};
+
+    template<class T>
+    using future_value_t = std::conditional_t<std::is_void<T>::value, void_value, T>;
+
+    /** The state shared by a goblin_future and the handler which will complete it.
+     *
+     * It is one slab_pool allocation, counted intrusively. Completion and attaching a continuation are lock-free:
+     * each side sets its bit in status_ and whichever side sets the second bit runs the continuation. asio requires
+     * handlers to be copyable, so there may be several producers; the first to claim the state sets the result.
+     */
+    template<class T>
+    struct future_state {
+        using value_type = future_value_t<T>;
+
+        static constexpr std::uint32_t ready = 1;
+        static constexpr std::uint32_t continued = 2;
+        static constexpr std::uint32_t claimed = 4;
+
+        static auto create() -> future_state * {
+            auto storage = slab_pool::allocate(sizeof(future_state));
+            return ::new(storage) future_state();
+        }
+
+        void add_ref() noexcept { references_.fetch_add(1, std::memory_order_relaxed); }
+
+        void add_producer() noexcept { producers_.fetch_add(1, std::memory_order_relaxed); }
+
+        /** @return true if that was the last producer */
+        bool drop_producer() noexcept { return producers_.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+        void release() noexcept {
+            if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                this->~future_state();
+                slab_pool::deallocate(this, sizeof(future_state));
+            }
+        }
+
+        /** Has no effect if a result has already been set */
+        template<class...Args>
+        void set_value(Args &&...args) {
+            if (not claim()) return;
+            value_.emplace(std::forward<Args>(args)...);
+            complete();
+        }
+
+        /** Has no effect if a result has already been set */
+        void set_exception(std::exception_ptr ep) {
+            if (not claim()) return;
+            error_ = std::move(ep);
+            complete();
+        }
+
+        bool is_ready() const { return status_.load(std::memory_order_acquire) & ready; }
+
+        /** Arrange for f() to be called, on whichever thread makes the state ready, once it is.
+         * Calls f() at once if the state is already ready. At most one continuation may be set. */
+        void set_continuation(unique_handler<void()> f) {
+            continuation_ = std::move(f);
+            if (status_.fetch_or(continued, std::memory_order_acq_rel) & ready) {
+                run_continuation();
+            }
+        }
+
+        auto take() -> value_type {
+            if (error_) std::rethrow_exception(error_);
+            return std::move(*value_);
+        }
+
+    private:
+        future_state() = default;
+
+        ~future_state() = default;
+
+        bool claim() {
+            return not(status_.fetch_or(claimed, std::memory_order_acquire) & claimed);
+        }
+
+        void complete() {
+            if (status_.fetch_or(ready, std::memory_order_acq_rel) & continued) {
+                run_continuation();
+            }
+        }
+
+        void run_continuation() {
+            auto f = std::move(continuation_);
+            f();
+        }
+
+        std::atomic<std::uint32_t> references_{2};
+        std::atomic<std::uint32_t> producers_{1};
+        std::atomic<std::uint32_t> status_{0};
+        boost::optional<value_type> value_;
+        std::exception_ptr error_;
+        unique_handler<void()> continuation_;
+    };
+
+    template<class T>
+    struct future_state_ptr {
+        future_state_ptr() noexcept = default;
+
+        explicit future_state_ptr(future_state<T> *p) noexcept : p_(p) {}
+
+        future_state_ptr(future_state_ptr const &other) noexcept : p_(other.p_) {
+            if (p_) p_->add_ref();
+        }
+
+        future_state_ptr(future_state_ptr &&other) noexcept : p_(std::exchange(other.p_, nullptr)) {}
+
+        future_state_ptr &operator=(future_state_ptr other) noexcept {
+            other.swap(*this);
+            return *this;
+        }
+
+        ~future_state_ptr() { if (p_) p_->release(); }
+
+        void swap(future_state_ptr &other) noexcept { std::swap(p_, other.p_); }
+
+        auto operator->() const -> future_state<T> * { return p_; }
+
+        explicit operator bool() const { return p_ != nullptr; }
+
+    private:
+        future_state<T> *p_ = nullptr;
+    };
+
+    // executors with post() (io_service, work_stealing_executor) are preferred over those with submit()
+    template<class Executor, class F>
+    auto post_to(Executor &executor, F &&f, int) -> decltype(executor.post(std::forward<F>(f))) {
+        return executor.post(std::forward<F>(f));
+    }
+
+    template<class Executor, class F>
+    auto post_to(Executor &executor, F &&f, long) -> decltype(executor.submit(std::forward<F>(f))) {
+        return executor.submit(std::forward<F>(f));
+    }
+
+
+    /** A producer's reference to a future_state. If the last producer is destroyed before a result has been set,
+     * the future completes with a broken_promise error, so that nobody waits forever.
+     */
+    template<class T>
+    class future_promise {
+    public:
+        explicit future_promise(future_state<T> *state) noexcept : state_(state) {}
+
+        future_promise(future_promise const &other) noexcept : state_(other.state_) {
+            if (state_) {
+                state_->add_ref();
+                state_->add_producer();
+            }
+        }
+
+        future_promise(future_promise &&other) noexcept : state_(std::exchange(other.state_, nullptr)) {}
+
+        future_promise &operator=(future_promise const &) = delete;
+
+        ~future_promise() {
+            if (not state_) return;
+            if (state_->drop_producer()) {
+                state_->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            }
+            state_->release();
+        }
+
+        template<class...Args>
+        void set_value(Args &&...args) {
+            state_->set_value(std::forward<Args>(args)...);
+        }
+
+        void set_exception(std::exception_ptr ep) {
+            state_->set_exception(std::move(ep));
+        }
+
+        auto get() const -> future_state<T> * { return state_; }
+
+    private:
+        future_state<T> *state_;
+    };
+
+    /** What a continuation F returns when continuation_invoker calls it with a Future.
+     * Spelled out rather than with std::result_of, which C++20 removed. */
+    template<class F, class Future>
+    using continuation_result_t = decltype(std::declval<std::decay_t<F> &>()(std::declval<Future>()));
+
+    template<class R>
+    struct continuation_invoker {
+        template<class F, class Future>
+        static void invoke(future_promise<R> &next, F &f, Future future) {
+            next.set_value(f(std::move(future)));
+        }
+    };
+
+    template<>
+    struct continuation_invoker<void> {
+        template<class F, class Future>
+        static void invoke(future_promise<void> &next, F &f, Future future) {
+            f(std::move(future));
+            next.set_value();
+        }
+    };
+
+    /// @brief Completion handler which completes a goblin_future with the result of an asynchronous operation.
+    template<class T>
+    class goblin_promise_handler;
+
+    template<>
+    class goblin_promise_handler<void> {
+    public:
+        explicit goblin_promise_handler(use_goblin_future_t)
+                : promise_(future_state<void>::create()) {}
+
+        void operator()(asio::error_code const &error) {
+            if (error) {
+                promise_.set_exception(std::make_exception_ptr(boost::system::system_error(error)));
+            } else {
+                promise_.set_value();
+            }
+        }
+
+        /** Called once by async_result to obtain the future. The state was created with a reference for it. */
+        auto take_future_state() -> future_state<void> * { return promise_.get(); }
+
+    private:
+        future_promise<void> promise_;
+    };
+}
+
+/** A move-only future completed by operations initiated with use_goblin_future.
+ *
+ * Compared with the boost::unique_future of use_unique_future, the shared state is a single pooled allocation,
+ * completion never takes a lock, and continuations are posted to the executor passed to then() rather than run
+ * on a new thread.
+ */
+template<class T>
+class goblin_future {
+    using state_type = detail::future_state<T>;
+
+public:
+    goblin_future() noexcept = default;
+
+    explicit goblin_future(state_type *state) noexcept : state_(state) {}
+
+    goblin_future(goblin_future &&) noexcept = default;
+
+    goblin_future &operator=(goblin_future &&) noexcept = default;
+
+    bool valid() const { return bool(state_); }
+
+    bool is_ready() const { return state_->is_ready(); }
+
+    /** Block until the result is available. Only the waiting thread uses a lock. */
+    void wait() {
+        if (state_->is_ready()) return;
+        struct waiter {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done = false;
+        } w;
+        state_->set_continuation([&w] {
+            auto lock = std::unique_lock<std::mutex>(w.mutex);
+            w.done = true;
+            w.cv.notify_one();
+        });
+        auto lock = std::unique_lock<std::mutex>(w.mutex);
+        w.cv.wait(lock, [&w] { return w.done; });
+    }
+
+    /** Wait for and return the result, or throw the exception it completed with */
+    auto get() -> T {
+        wait();
+        auto state = std::move(state_);
+        return get_value(state->take());
+    }
+
+    /** Post f(ready_future) to the executor once this future is ready.
+     * The executor may be anything with post() (io_service, work_stealing_executor) or submit() (asio_executor)
+     * The continuation, and so f, is copied if the executor copies its handlers. Invalidates this future.
+     * @return a future for the result of f
+     */
+    template<class Executor, class F>
+    auto then(Executor &executor, F &&f) -> goblin_future<detail::continuation_result_t<F, goblin_future>> {
+        using result_type = detail::continuation_result_t<F, goblin_future>;
+        auto next_state = detail::future_state<result_type>::create();
+        auto result = goblin_future<result_type>(next_state);
+        auto next = detail::future_promise<result_type>(next_state);
+
+        auto state = std::move(state_);
+        auto &raw = *state.operator->();
+        // the continuation holds a reference to its own state until it runs, when it is moved out
+        raw.set_continuation([&executor, next = std::move(next), state = std::move(state),
+                                     f = std::forward<F>(f)]() mutable {
+            detail::post_to(executor, [next = std::move(next), state = std::move(state),
+                                       f = std::move(f)]() mutable {
+                try {
+                    detail::continuation_invoker<result_type>::invoke(next, f, goblin_future(std::move(state)));
+                }
+                catch (...) {
+                    next.set_exception(std::current_exception());
+                }
+            }, 0);
+        });
+        return result;
+    }
+
+private:
+    explicit goblin_future(detail::future_state_ptr<T> state) noexcept : state_(std::move(state)) {}
+
+    static void get_value(detail::void_value) {}
+
+    template<class U>
+    static auto get_value(U &&u) -> U { return std::forward<U>(u); }
+
+    detail::future_state_ptr<T> state_;
+};
+
+namespace boost {
+namespace asio {
+
+/// @brief Handler type specialization for use_goblin_future.
+template <typename ReturnType>
+struct handler_type<
+    use_goblin_future_t,
+    ReturnType(boost::system::error_code)>
+{
+  typedef ::detail::goblin_promise_handler<void> type;
+};
+
+/// @brief Handler traits specialization for goblin_promise_handler.
+template <typename T>
+class async_result< ::detail::goblin_promise_handler<T> >
+{
+public:
+  // The initiating function will return a goblin_future.
+  typedef goblin_future<T> type;
+
+  explicit async_result(::detail::goblin_promise_handler<T>& handler)
+    : value_(handler.take_future_state())
+  {}
+
+  // Obtain the future to be returned from the initiating function.
+  type get() { return std::move(value_); }
+
+private:
+  type value_;
+};
+
+} // namespace asio
+} // namespace boost
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <atomic>
+#include <chrono>
+
+/** A clock for an io_service which only moves when it is told to.
+ *
+ * If an io_service has this service, its timing_wheel_service reads the time from here instead of the steady
+ * clock, and never arms a real timer: whoever advances the clock (a goblin_simulation) also runs the wheel.
+ * The clock starts at the steady clock's time when it is installed, so its time points can be compared with
+ * ones taken before, but only the time elapsed since then is reproducible.
+ */
+struct virtual_clock_service : asio::detail::service_base<virtual_clock_service> {
+    using clock_type = std::chrono::steady_clock;
+    using time_point = clock_type::time_point;
+    using duration = clock_type::duration;
+
+    virtual_clock_service(asio::io_service &owner)
+            : asio::detail::service_base<virtual_clock_service>(owner),
+              start_(clock_type::now()) {}
+
+    auto now() const -> time_point {
+        return start_ + elapsed();
+    }
+
+    auto elapsed() const -> duration {
+        return duration(elapsed_.load(std::memory_order_acquire));
+    }
+
+    /** Move the clock forward to when. The clock never goes back, so an earlier time is ignored. */
+    void advance_to(time_point when) {
+        auto target = (when - start_).count();
+        auto current = elapsed_.load(std::memory_order_relaxed);
+        while (current < target and
+               not elapsed_.compare_exchange_weak(current, target, std::memory_order_acq_rel)) {}
+    }
+
+private:
+    void shutdown_service() override {}
+
+    time_point const start_;
+    std::atomic<duration::rep> elapsed_{0};
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "config.hpp"
+#include "work_stealing_service.hpp"
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** A drop-in alternative to run_pool whose threads are workers of the io_service's work_stealing_service.
+ * Handlers posted through the service are scheduled on per-thread deques; everything else posted to the
+ * io_service runs as it would under run_pool.
+ */
+struct work_stealing_pool {
+    work_stealing_pool(asio::io_service &executor, std::string identifier)
+            : executor_(executor)
+            , service_(asio::use_service<work_stealing_service>(executor))
+            , identifier_(std::move(identifier))
+    {
+
+    }
+
+    ~work_stealing_pool() {
+        stop();
+    }
+
+    void add_thread() {
+        threads_.emplace_back([&, work = asio::io_service::work(executor_)] { this->run(); });
+    }
+
+    void stop() {
+        executor_.stop();
+        join_threads();
+    }
+
+    void join() {
+        run();
+        join_threads();
+    }
+
+private:
+
+    void join_threads() {
+        for (auto &&t : threads_) {
+            if (t.joinable()) t.join();
+        }
+        threads_.clear();
+    }
+
+    void run() {
+        while (!executor_.stopped()) {
+            try {
+                service_.run_worker();
+            }
+            catch (std::exception const &e) {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+    }
+
+    asio::io_service &executor_;
+    work_stealing_service &service_;
+    std::vector<std::thread> threads_;
+    std::string identifier_;
+};
@@ -0,0 +1,282 @@
+#pragma once
+
+#include "config.hpp"
+#include "unique_handler.hpp"
+
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** A work-stealing scheduler for the handlers posted to an io_service.
+ *
+ * asio's io_service keeps one queue shared by every thread which runs it. When many small handlers are posted
+ * (as when many goblins complete their waiters at once), that queue and its lock become the
+ * bottleneck. This service gives each worker thread its own deque instead. A worker posts to, and runs from,
+ * the back of its own deque; an idle worker steals from the front of the others'. Threads which are not
+ * workers spread their posts round-robin over the deques. Every fairness_interval tasks a worker instead runs
+ * the oldest task on its deque and one io_service handler, so that neither starves while it keeps busy.
+ *
+ * Workers still run the io_service, so timers, sockets and handlers posted directly to it keep working. A
+ * worker with nothing to do parks in io_service::run_one(), and is woken by posting an empty handler when work
+ * arrives on a deque. Only one wake-up is pending at a time; the worker it wakes passes it on if there is more
+ * work than it can take.
+ *
+ * Until a worker is running, post() and dispatch() fall straight through to the io_service.
+ */
+struct work_stealing_service : asio::detail::service_base<work_stealing_service> {
+    using task_type = unique_handler<void()>;
+
+    static constexpr std::size_t fairness_interval = 32;
+
+    work_stealing_service(asio::io_service &owner)
+            : asio::detail::service_base<work_stealing_service>(owner),
+              queues_(std::max(1u, std::thread::hardware_concurrency())) {}
+
+    /** Arrange for handler() to be called by one of the workers. Never calls the handler immediately. */
+    template<class Handler>
+    void post(Handler &&handler) {
+        if (workers_.load() == 0) {
+            get_io_service().post(std::forward<Handler>(handler));
+            return;
+        }
+        push(task_type(std::forward<Handler>(handler)));
+    }
+
+    /** Call handler() now if the calling thread is one of this service's workers, otherwise post it */
+    template<class Handler>
+    void dispatch(Handler &&handler) {
+        if (running_in_this_thread()) {
+            handler();
+        } else {
+            post(std::forward<Handler>(handler));
+        }
+    }
+
+    bool running_in_this_thread() const {
+        return current_worker().service == this;
+    }
+
+    /** Keep the io_service's run() from returning until the matching work_finished(), as an io_service::work
+     * would. Any number of outstanding operations share one io_service::work, so this is one atomic increment
+     * unless it is the first.
+     */
+    void work_started() {
+        if (outstanding_.fetch_add(1) == 0) update_work();
+    }
+
+    void work_finished() {
+        if (outstanding_.fetch_sub(1) == 1) update_work();
+    }
+
+    /** Run one queued task or io_service handler on the calling thread, if there is one. Does not block.
+     * @return the number of handlers run
+     */
+    auto poll_one() -> std::size_t {
+        auto index = running_in_this_thread() ? current_worker().index : 0;
+        if (run_one_task(index)) return 1;
+        return get_io_service().poll_one();
+    }
+
+    /** Make the calling thread a worker until the io_service is stopped.
+     * Exceptions thrown by tasks propagate out of this function.
+     */
+    void run_worker() {
+        auto &executor = get_io_service();
+        worker_scope scope(*this, next_index_.fetch_add(1) % queues_.size());
+        auto index = current_worker().index;
+
+        std::size_t turn = 0;
+        while (not executor.stopped()) {
+            if (++turn % fairness_interval == 0) {
+                executor.poll_one();
+                if (run_one_task(index, oldest_first)) continue;
+            }
+            if (run_one_task(index)) continue;
+            if (executor.poll_one()) continue;
+
+            idle_.fetch_add(1);
+            // any push after this point will see us idle and wake us
+            if (has_tasks()) {
+                idle_.fetch_sub(1);
+                continue;
+            }
+            executor.run_one();
+            idle_.fetch_sub(1);
+        }
+    }
+
+private:
+
+    /** One worker's deque, aligned so that no two workers' queues share a cache line */
+    struct alignas(64) task_queue {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+        std::atomic<std::size_t> size{0};
+    };
+
+    struct worker_identity {
+        work_stealing_service const *service = nullptr;
+        std::size_t index = 0;
+    };
+
+    static auto current_worker() -> worker_identity & {
+        static thread_local worker_identity identity;
+        return identity;
+    }
+
+    struct worker_scope {
+        worker_scope(work_stealing_service &service, std::size_t index)
+                : service_(service), previous_(current_worker()) {
+            current_worker() = worker_identity{&service, index};
+            service_.workers_.fetch_add(1);
+        }
+
+        worker_scope(worker_scope const &) = delete;
+
+        worker_scope &operator=(worker_scope const &) = delete;
+
+        ~worker_scope() {
+            service_.workers_.fetch_sub(1);
+            current_worker() = previous_;
+        }
+
+    private:
+        work_stealing_service &service_;
+        worker_identity previous_;
+    };
+
+    void shutdown_service() override {
+        {
+            auto lock = std::unique_lock<std::mutex>(work_mutex_);
+            shut_down_ = true;
+            work_.reset();
+        }
+        std::vector<task_type> abandoned;
+        for (auto &queue : queues_) {
+            auto lock = std::unique_lock<std::mutex>(queue.mutex);
+            std::move(queue.tasks.begin(), queue.tasks.end(), std::back_inserter(abandoned));
+            queue.tasks.clear();
+            queue.size.store(0);
+        }
+    }
+
+    /** Hold the io_service::work while anything is outstanding. The count is read again under the lock, since it
+     * may have gone back and forth since the caller saw it cross zero. */
+    void update_work() {
+        auto lock = std::unique_lock<std::mutex>(work_mutex_);
+        if (outstanding_.load() == 0) {
+            work_.reset();
+        } else if (not work_ and not shut_down_) {
+            work_ = std::make_unique<asio::io_service::work>(get_io_service());
+        }
+    }
+
+    void push(task_type task) {
+        auto index = running_in_this_thread()
+                     ? current_worker().index
+                     : next_index_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        auto &queue = queues_[index];
+        {
+            auto lock = std::unique_lock<std::mutex>(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+            queue.size.store(queue.tasks.size());
+        }
+        wake_one();
+    }
+
+    /** Wake a parked worker, unless a wake-up is already on its way. It will find the task on its own deque or
+     * steal it. */
+    void wake_one() {
+        if (idle_.load() == 0 or wake_pending_.exchange(true)) return;
+        get_io_service().post([this] {
+            wake_pending_.store(false);
+            if (has_tasks()) wake_one();
+        });
+    }
+
+    enum pop_order { newest_first, oldest_first };
+
+    bool run_one_task(std::size_t index, pop_order order = newest_first) {
+        task_type task;
+        if (pop(queues_[index], task, order) or steal(index, task)) {
+            task();
+            return true;
+        }
+        return false;
+    }
+
+    static bool pop(task_queue &queue, task_type &task, pop_order order) {
+        if (queue.size.load(std::memory_order_relaxed) == 0) return false;
+        auto lock = std::unique_lock<std::mutex>(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        if (order == newest_first) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        queue.size.store(queue.tasks.size());
+        return true;
+    }
+
+    bool steal(std::size_t thief, task_type &task) {
+        for (std::size_t i = 1; i < queues_.size(); ++i) {
+            auto &victim = queues_[(thief + i) % queues_.size()];
+            if (victim.size.load(std::memory_order_relaxed) == 0) continue;
+            auto lock = std::unique_lock<std::mutex>(victim.mutex, std::try_to_lock);
+            if (not lock.owns_lock() or victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            victim.size.store(victim.tasks.size());
+            return true;
+        }
+        return false;
+    }
+
+    bool has_tasks() const {
+        for (auto const &queue : queues_) {
+            if (queue.size.load()) return true;
+        }
+        return false;
+    }
+
+    std::vector<task_queue> queues_;
+    std::atomic<std::size_t> next_index_{0};
+    std::atomic<std::size_t> workers_{0};
+    std::atomic<std::size_t> idle_{0};
+    std::atomic<bool> wake_pending_{false};
+    std::atomic<std::size_t> outstanding_{0};
+    std::mutex work_mutex_;
+    std::unique_ptr<asio::io_service::work> work_;
+    bool shut_down_ = false;
+};
+
+/** A handle to the work_stealing_service of an io_service with the post/dispatch/poll_one/stop interface of an
+ * io_service, so that it can stand in for one, for example with make_asio_executor.
+ */
+struct work_stealing_executor {
+    explicit work_stealing_executor(asio::io_service &owner)
+            : service_(std::addressof(asio::use_service<work_stealing_service>(owner))) {}
+
+    template<class Handler>
+    void post(Handler &&handler) { service_->post(std::forward<Handler>(handler)); }
+
+    template<class Handler>
+    void dispatch(Handler &&handler) { service_->dispatch(std::forward<Handler>(handler)); }
+
+    auto poll_one() -> std::size_t { return service_->poll_one(); }
+
+    void stop() { service_->get_io_service().stop(); }
+
+    bool stopped() const { return service_->get_io_service().stopped(); }
+
+    bool running_in_this_thread() const { return service_->running_in_this_thread(); }
+
+private:
+    work_stealing_service *service_;
+};
@@ -3,24 +3,151 @@
 #include "config.hpp"
 #include "run_pool.hpp"
 
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/** How the worker_thread_service of an io_service runs goblin work.
+ *
+ * By default there is one worker executor run by a single thread. With sharded set, there is one executor per
+ * shard, each run by its own threads, and every goblin belongs to exactly one shard. Goblins in different
+ * shards never contend for a thread, a timing wheel or an io_service queue.
+ */
+struct worker_thread_options {
+    /** The number of threads running each worker executor */
+    std::size_t threads_per_executor = 1;
+
+    /** Give each shard its own io_service */
+    bool sharded = false;
+
+    /** The number of shards. Zero means one per hardware thread. Ignored unless sharded. */
+    std::size_t shard_count = 0;
+
+    /** Pin the threads of shard n to cpu n modulo the number of cpus. Only supported on linux. */
+    bool pin_threads = false;
+
+    /** Run goblin work on the owning io_service itself, with no executors or threads of its own, so that
+     * whatever runs the owner runs everything. Overrides every other option. Used by goblin_simulation.
+     */
+    bool inline_executor = false;
+
+    static auto inline_only() -> worker_thread_options {
+        worker_thread_options options;
+        options.inline_executor = true;
+        return options;
+    }
+
+    static auto per_core() -> worker_thread_options {
+        worker_thread_options options;
+        options.sharded = true;
+        options.pin_threads = true;
+        return options;
+    }
+};
+
 struct worker_thread_service : asio::detail::service_base<worker_thread_service> {
 
     worker_thread_service(asio::io_service &owner)
+            : worker_thread_service(owner, worker_thread_options()) {}
+
+    worker_thread_service(asio::io_service &owner, worker_thread_options options)
             : asio::detail::service_base<worker_thread_service>(owner) {
-        worker_pool_.add_thread();
+        if (options.inline_executor) return;
+        std::size_t count = options.sharded ? options.shard_count : 1;
+        if (count == 0) {
+            count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        auto threads = std::max<std::size_t>(1, options.threads_per_executor);
+
+        shards_.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            shards_.push_back(std::make_unique<shard>("worker_thread_service"));
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            for (std::size_t t = 0; t < threads; ++t) {
+                if (options.pin_threads) {
+                    shards_[i]->pool.add_thread([i] { pin_to_cpu(i); });
+                } else {
+                    shards_[i]->pool.add_thread();
+                }
+            }
+        }
     }
 
+    /** The executor of the first shard, or the owner if the executor is inline */
     auto get_worker_executor() -> asio::io_service&
     {
-        return worker_executor_;
+        if (shards_.empty()) return get_io_service();
+        return shards_.front()->executor;
+    }
+
+    /** The executor of the shard which owns the goblin with the given key.
+     * Keys are hashed, so sequential keys spread evenly across shards.
+     */
+    auto get_worker_executor(std::uint64_t key) -> asio::io_service&
+    {
+        if (shards_.size() <= 1) return get_worker_executor();
+        return shards_[mix(key) % shards_.size()]->executor;
+    }
+
+    auto shard_count() const -> std::size_t {
+        return std::max<std::size_t>(1, shards_.size());
     }
 
     void shutdown_service() override
     {
-        worker_pool_.stop();
+        for (auto &s : shards_) {
+            s->pool.stop();
+        }
     }
 
-    asio::io_service worker_executor_;
-    run_pool worker_pool_ {worker_executor_, "worker_thread_service"};
+private:
+
+    struct shard {
+        shard(std::string identifier) : pool(executor, std::move(identifier)) {}
 
+        asio::io_service executor;
+        run_pool pool;
+    };
+
+    /** splitmix64 finaliser */
+    static auto mix(std::uint64_t x) -> std::uint64_t {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+
+    static void pin_to_cpu(std::size_t index) {
+#if defined(__linux__)
+        auto cpus = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(index % cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void) index;
+#endif
+    }
+
+    std::vector<std::unique_ptr<shard>> shards_;
 };
+
+/** Configure the worker threads of an io_service.
+ * Must be called before anything on that io_service uses the worker_thread_service, i.e. before the
+ * first goblin is constructed. Throws asio::service_already_exists otherwise.
+ */
+inline auto install_worker_threads(asio::io_service &owner, worker_thread_options options)
+-> worker_thread_service & {
+    auto service = std::make_unique<worker_thread_service>(owner, options);
+    asio::add_service(owner, service.get());
+    return *service.release();
+}
@@ -0,0 +1,106 @@
+// goblin-trace-decode: print a goblin trace dump, written by goblin_trace::dump, as one timeline.
+//
+// usage: goblin-trace-decode <dump file> [goblin id]
+
+#include "goblin_trace_format.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct decoded_record {
+        double nanoseconds;
+        trace_record record;
+    };
+
+    template<class T>
+    bool read_into(std::istream &is, T &t) {
+        return bool(is.read(reinterpret_cast<char *>(&t), sizeof(t)));
+    }
+
+    /** Convert ticks to nanoseconds by interpolating between the two readings in the header */
+    auto to_nanoseconds(trace_file_header const &header, std::uint64_t ticks) -> double {
+        auto tick_span = double(header.dump_ticks) - double(header.start_ticks);
+        auto ns_span = double(header.dump_nanoseconds) - double(header.start_nanoseconds);
+        auto ns_per_tick = tick_span > 0 ? ns_span / tick_span : 1.0;
+        return double(header.start_nanoseconds) + (double(ticks) - double(header.start_ticks)) * ns_per_tick;
+    }
+
+    /** A slot only holds a record which is one of the last capacity written, and belongs in that slot.
+     * Anything else was never written, or was being overwritten while the dump was taken, which the dump
+     * marks with sequence 0, or was written after the dump read the ring's count. */
+    bool belongs(trace_ring_header const &ring, std::uint64_t capacity, std::uint64_t slot, trace_record const &r) {
+        if (r.sequence == 0 or r.sequence > ring.written) return false;
+        if (ring.written - r.sequence >= capacity) return false;
+        return (r.sequence - 1) % capacity == slot;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <dump file> [goblin id]" << std::endl;
+        return 2;
+    }
+    auto only_goblin = argc > 2;
+    auto goblin = only_goblin ? std::stoull(argv[2]) : 0;
+
+    std::ifstream in(argv[1], std::ios::binary);
+    trace_file_header header;
+    if (not in or not read_into(in, header)) {
+        std::cerr << argv[1] << ": cannot read header" << std::endl;
+        return 1;
+    }
+    if (std::memcmp(header.magic, trace_file_header::expected_magic(), sizeof(header.magic)) != 0
+        or header.version != trace_file_header::current_version) {
+        std::cerr << argv[1] << ": not a goblin trace, or an unsupported version" << std::endl;
+        return 1;
+    }
+
+    std::vector<decoded_record> timeline;
+    std::size_t dropped = 0;
+    std::vector<trace_record> records(header.ring_capacity);
+    for (std::uint32_t i = 0; i < header.ring_count; ++i) {
+        trace_ring_header ring;
+        if (not read_into(in, ring)
+            or not in.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(trace_record))) {
+            std::cerr << argv[1] << ": truncated at ring " << i << std::endl;
+            return 1;
+        }
+        auto kept = std::min<std::uint64_t>(ring.written, header.ring_capacity);
+        std::size_t found = 0;
+        for (std::uint64_t slot = 0; slot < records.size(); ++slot) {
+            auto const &r = records[slot];
+            if (not belongs(ring, header.ring_capacity, slot, r)) continue;
+            ++found;
+            if (only_goblin and r.goblin != goblin) continue;
+            timeline.push_back({to_nanoseconds(header, r.timestamp), r});
+        }
+        dropped += kept - found;
+    }
+
+    std::stable_sort(timeline.begin(), timeline.end(), [](auto const &l, auto const &r) {
+        return l.nanoseconds < r.nanoseconds;
+    });
+
+    auto origin = timeline.empty() ? 0.0 : timeline.front().nanoseconds;
+    std::cout << std::fixed << std::setprecision(3);
+    for (auto const &d : timeline) {
+        auto const &r = d.record;
+        std::cout << std::setw(14) << (d.nanoseconds - origin) / 1000.0 << " us"
+                  << "  thread " << std::setw(3) << r.thread
+                  << "  goblin " << std::setw(6) << r.goblin
+                  << "  " << std::left << std::setw(22) << trace_event_name(r.event) << std::right
+                  << trace_state_name(r.from);
+        if (r.to != r.from) std::cout << " -> " << trace_state_name(r.to);
+        std::cout << '\n';
+    }
+    if (dropped) {
+        std::cerr << dropped << " records were being overwritten when the dump was taken" << std::endl;
+    }
+}
@@ -0,0 +1 @@
+sugar_files(TRACE_DECODER_SOURCES goblin_trace_decode.cpp)